@@ -3,23 +3,23 @@
 #include "libs/hash_table.h"
 #include "libs/temp_alloc.h"
 
-#define ht_insert_lexer_token_value(ht, key, value) ht_insert_generic_value(ht, key, struct lexer_token_value, value)
-#define ht_search_lexer_token_value(ht, key)        ht_search_generic_value(ht, key, struct lexer_token_value)
+#define ht_upsert_lexer_token_value(map, key, value) ({ struct lexer_token_value _v = value; ht_map_upsert(map, key, &_v); })
+#define ht_find_lexer_token_value(map, key)          (struct lexer_token_value*)ht_map_find(map, key)
 
-char* string_view_to_char(string_view s)
-{
-    static char n[256];
-    ht_to_char(n, (void*)s.data, s.count + 1);
-    return n;
-}
+// Environments and their small maps share one allocator per thread, which
+// lives as long as any environment does
+static _Thread_local temp_allocator env_heap = {0};
+static _Thread_local size_t env_live = 0;
 
 struct Enviroment* env_init(struct Enviroment* enclosing)
 {
-    temp_allocator allocator = temp_init();
-    struct Enviroment* env = temp_alloc(allocator, sizeof(struct Enviroment));
+    if (env_live++ == 0) {
+        env_heap = temp_init();
+        temp_set_name(env_heap, "environment");
+    }
+    struct Enviroment* env = temp_alloc(env_heap, sizeof(struct Enviroment));
 
-    env->allocator = allocator;
-    env->values = ht_init_with_capacity(7);
+    ht_map_init(&env->values, env_heap, sizeof(struct lexer_token_value));
     env->enclosing = enclosing;
 
     return env;
@@ -27,28 +27,28 @@ struct Enviroment* env_init(struct Enviroment* enclosing)
 
 void env_destroy(struct Enviroment* env)
 {
-    ht_free(env->values);
+    ht_map_free(&env->values);
     // if (env->enclosing != NULL) env_destroy(env->enclosing);
-    temp_uninit(env->allocator);
     temp_free(env);
+
+    if (--env_live == 0) {
+        temp_uninit(env_heap);
+        env_heap = (temp_allocator){0};
+    }
 }
 
-void env_define(struct Enviroment* env, string_view name, struct lexer_token_value value)
+void env_define(struct Enviroment* env, const symbol* name, struct lexer_token_value value)
 {
-    char* n = string_view_to_char(name);
-
-    ht_insert_lexer_token_value(env->values, n, value);
-    // temp_free(n);
+    ht_upsert_lexer_token_value(&env->values, name, value);
 }
 
 struct Error* env_get(struct Enviroment* env, lexer_token name, struct lexer_token_value* value)
 {
     struct Error* error = NULL;
 
-    char* n = string_view_to_char(name.lexeme);
-
-    if (ht_has(env->values, n)) {
-        *value = *ht_search_lexer_token_value(env->values, n);
+    struct lexer_token_value* current_value = ht_find_lexer_token_value(&env->values, name.symbol);
+    if (current_value != NULL) {
+        *value = *current_value;
         return_defer(error, NULL);
     }
 
@@ -57,7 +57,6 @@ struct Error* env_get(struct Enviroment* env, lexer_token name, struct lexer_tok
     return_defer(error, error_f("at %s:%zu:%zu Undefined variable %.*s", lex_loc_fmt(name), sv_fmt(name.lexeme)));
 
 defer:
-    // temp_free(n);
     return error;
 }
 
@@ -65,10 +64,8 @@ struct Error* env_assign(struct Enviroment* env, lexer_token name, struct lexer_
 {    
     struct Error* error = NULL;
 
-    char* n = string_view_to_char(name.lexeme);
-
-    if (ht_has(env->values, n)) {
-        struct lexer_token_value* current_value = ht_search_lexer_token_value(env->values, n);
+    struct lexer_token_value* current_value = ht_find_lexer_token_value(&env->values, name.symbol);
+    if (current_value != NULL) {
         *current_value = value; 
         return_defer(error, NULL);
     }
@@ -78,6 +75,5 @@ struct Error* env_assign(struct Enviroment* env, lexer_token name, struct lexer_
     return_defer(error, error_f("at %s:%zu:%zu Undefined variable %.*s", lex_loc_fmt(name), sv_fmt(name.lexeme)));
 
 defer:
-    // temp_free(n);
     return error;
 }
@@ -5,8 +5,7 @@
 #include "libs/temp_alloc.h"
 
 struct Enviroment {
-    hash_table* values;
-    temp_allocator allocator;
+    ht_map values;
 
     struct Enviroment* enclosing;
 };
@@ -14,6 +13,6 @@ struct Enviroment {
 struct Enviroment* env_init(struct Enviroment* enclosing);
 void env_destroy(struct Enviroment* env);
 
-void env_define(struct Enviroment* env, string_view name, struct lexer_token_value value);
+void env_define(struct Enviroment* env, const symbol* name, struct lexer_token_value value);
 struct Error* env_get(struct Enviroment* env, lexer_token name, struct lexer_token_value* value);
 struct Error* env_assign(struct Enviroment* env, lexer_token name, struct lexer_token_value value);
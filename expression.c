@@ -106,7 +106,7 @@ void free_expr(struct Expr* expr)
         break;
     case EXPR_CALL:
         free_expr(expr->call.calle);
-        da_free(expr->call.arguments);
+        sda_free(expr->call.arguments);
         break;
     case EXPR_VAR:
         break; // No dynamic memory in variable
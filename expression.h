@@ -3,11 +3,9 @@
 #include "lexer.h"
 #include "libs/temp_alloc.h"
 
-typedef struct {
-    size_t count;
-    size_t capacity;
-    struct Expr** items;
-} Exprs;
+// Small-buffer arrays: most calls have a handful of arguments and most
+// blocks a handful of statements, those never allocate
+typedef da_small(struct Expr*, 4) Exprs;
 
 typedef enum {
     EXPR_BINARY,
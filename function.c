@@ -79,21 +79,21 @@ void init_native_functions(struct Interpreter* intp)
     clock.callable_value.arity = 0;
     clock.callable_value.call = native_clock_fun;
     
-    env_define(intp->global_env, sv_from_cstr("clock"), clock);
+    env_define(intp->global_env, symbol_intern(sv_from_cstr("clock")), clock);
     
     struct lexer_token_value println;
     println.type = VALUE_TYPE_CALLABLE;
     println.callable_value.arity = 1;
     println.callable_value.call = native_println_fun;
     
-    env_define(intp->global_env, sv_from_cstr("println"), println);
+    env_define(intp->global_env, symbol_intern(sv_from_cstr("println")), println);
 
     struct lexer_token_value print;
     print.type = VALUE_TYPE_CALLABLE;
     print.callable_value.arity = 1;
     print.callable_value.call = native_print_fun;
 
-    env_define(intp->global_env, sv_from_cstr("print"), print);
+    env_define(intp->global_env, symbol_intern(sv_from_cstr("print")), print);
 }
 
 struct Error* callable_function(struct callable_value value, struct Interpreter* intp, Arguments* args, struct lexer_token_value* return_value)
@@ -102,15 +102,15 @@ struct Error* callable_function(struct callable_value value, struct Interpreter*
 
     struct Enviroment* env = env_init(value.closure);
     for (int i = 0; i < value.declaration->function_stmt.params->count; i++) {
-        env_define(env, value.declaration->function_stmt.params->items[i].lexeme, args->items[i]);
+        env_define(env, value.declaration->function_stmt.params->items[i].symbol, args->items[i]);
     }
 
+    // execute_block destroys env on success
     if (has_error(execute_block(intp, value.declaration->function_stmt.body, env, return_value))) {
         env_destroy(env);
         return trace(error);
     }
 
-    env_destroy(env);
     return NULL;
 }
 
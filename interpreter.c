@@ -192,16 +192,20 @@ struct Error* visit_call_expr(struct Interpreter* intp, struct Expr* expr, struc
         return trace(error);
     }
 
-    Arguments* arguments = NULL;
-    da_init(arguments);
-
-    for (int i = 0; i < expr->call.arguments->count; i++) {
+    // Argument arrays are statement temporaries, they are released in bulk
+    // when the enclosing statement or loop iteration rewinds intp->allocator
+    size_t count = expr->call.arguments->count;
+    Arguments* arguments = temp_alloc(intp->allocator, sizeof(Arguments));
+    arguments->items = temp_alloc(intp->allocator, count * sizeof(struct lexer_token_value));
+    arguments->capacity = count;
+
+    for (size_t i = 0; i < count; i++) {
         struct lexer_token_value argument = {0};
         if (has_error(evaluate(intp, expr->call.arguments->items[i], &argument))) {
             return trace(error);
         }
 
-        da_append(arguments, argument);
+        arguments->items[arguments->count++] = argument;
     }
 
     if (calle.type != VALUE_TYPE_CALLABLE) {
@@ -264,7 +268,7 @@ struct Error* visit_variable_stmt(struct Interpreter* intp, struct Stmt* stmt)
         }
     }
 
-    env_define(intp->env, stmt->variable.name.lexeme, value);
+    env_define(intp->env, stmt->variable.name.symbol, value);
     return NULL;
 }
 
@@ -337,6 +341,8 @@ struct Error* visit_while_stmt(struct Interpreter* intp, struct Stmt* stmt, stru
         return trace(error);
     }
 
+    temp_checkpoint checkpoint = temp_save(intp->allocator);
+
     while (is_truthy(value.int_value)) {
         if (has_error(execute_block(intp, stmt->while_stmt.body->block.statements, env_init(intp->env), return_value))) {
             return trace(error);
@@ -345,6 +351,8 @@ struct Error* visit_while_stmt(struct Interpreter* intp, struct Stmt* stmt, stru
         if (has_error(evaluate(intp, stmt->while_stmt.condition, &value))) {
             return trace(error);
         }
+
+        temp_rewind(intp->allocator, checkpoint); // Drop this iteration's temporaries
     }
 
     return NULL;
@@ -354,7 +362,7 @@ struct Error* visit_function_stmt(struct Interpreter* intp, struct Stmt* stmt)
 {
     struct Error* error = NULL;
     struct lexer_token_value function = create_function(stmt, intp->env);
-    env_define(intp->env, stmt->function_stmt.name.lexeme, function);
+    env_define(intp->env, stmt->function_stmt.name.symbol, function);
     // printf("(define) env: %p name: %.*s\n", intp->env, sv_fmt(stmt->function_stmt.name.lexeme));
     return NULL;
 }
@@ -404,6 +412,7 @@ struct Interpreter* interpreter_init()
     struct Interpreter* intp = malloc(sizeof(struct Interpreter));
     
     intp->allocator = temp_init();
+    temp_set_name(intp->allocator, "interpreter");
     intp->global_env = env_init(NULL);
     intp->env = intp->global_env;
 
@@ -415,6 +424,7 @@ struct Interpreter* interpreter_init()
 void interpreter_destroy(struct Interpreter* intp)
 {
     env_destroy(intp->env);
+    temp_uninit(intp->allocator);
     free(intp);
 }
 
@@ -425,8 +435,10 @@ struct Error* interpret(struct Interpreter* intp, Stmts* stmts)
     struct lexer_token_value* return_value = NULL;
 
     for (size_t i = 0; i < stmts->count; i++) {
-        if (has_error(execute(intp, stmts->items[i], return_value))) {
-            return trace(error);
+        temp_scope(intp->allocator) {
+            if (has_error(execute(intp, stmts->items[i], return_value))) {
+                return trace(error);
+            }
         }
     }
 
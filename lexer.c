@@ -182,6 +182,7 @@ another_trim_round:
                 break;
             }
         }
+        t->symbol = t->id == LEXER_SYMBOL ? symbol_intern(t->lexeme) : NULL;
 
         return true;
     }
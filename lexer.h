@@ -1,6 +1,7 @@
 #pragma once
 
 #include "libs/string.h"
+#include "libs/symbol.h"
 
 #define lex_loc_fmt(t)      t.loc.file_path, t.loc.row, t.loc.col
 #define lex_loc_fmt_ptr(t)  t->loc.file_path, t->loc.row, t->loc.col
@@ -61,15 +62,12 @@ struct lexer_token_value {
 typedef struct {
     lexer_token_kind id;
     string_view lexeme;
+    const symbol* symbol;   // interned lexeme of LEXER_SYMBOL tokens
     struct lexer_token_value value;
     location loc;
 } lexer_token;
 
-typedef struct {
-    size_t count;
-    size_t capacity;
-    lexer_token* items;
-} LexerTokens;
+typedef da_small(lexer_token, 4) LexerTokens;
 
 typedef struct {
     string_view source;
@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../temp_alloc.h"
+
+static const bench benches[] = {
+    { "hash_table",       bench_hash_table },
+    { "hash_table_batch", bench_hash_table_batch },
+    { "temp_alloc",       bench_temp_alloc },
+    { "string",           bench_string },
+    { "dynamic_array",    bench_dynamic_array },
+};
+
+//
+// malloc counting: glibc lets the program replace malloc and still reach the
+// real one through the __libc_* entry points
+//
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static size_t bench_mallocs = 0;
+
+void* malloc(size_t size)
+{
+    bench_mallocs++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    bench_mallocs++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    bench_mallocs++;
+    return __libc_realloc(ptr, size);
+}
+
+//
+// Hardware counters, read as one group so they cover the same interval
+//
+#define BENCH_COUNTERS 4
+
+static const struct { uint64_t config; const char* name; } bench_counter_kinds[BENCH_COUNTERS] = {
+    { PERF_COUNT_HW_CPU_CYCLES,       "cycles" },
+    { PERF_COUNT_HW_INSTRUCTIONS,     "instrs" },
+    { PERF_COUNT_HW_CACHE_MISSES,     "cache-miss" },
+    { PERF_COUNT_HW_BRANCH_MISSES,    "branch-miss" },
+};
+
+static int bench_counter_fds[BENCH_COUNTERS] = { -1, -1, -1, -1 };
+
+static void bench_counters_open()
+{
+    for (int i = 0; i < BENCH_COUNTERS; i++) {
+        struct perf_event_attr attr = {0};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = bench_counter_kinds[i].config;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        int group = i == 0 ? -1 : bench_counter_fds[0];
+        bench_counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+        if (bench_counter_fds[i] < 0) {
+            // Not permitted (perf_event_paranoid, containers) or no PMU
+            for (int j = 0; j < i; j++) close(bench_counter_fds[j]);
+            bench_counter_fds[0] = -1;
+            fprintf(stderr, "bench: hardware counters unavailable, reporting time and allocations only\n");
+            return;
+        }
+    }
+}
+
+static bool bench_counters_read(uint64_t* values)
+{
+    if (bench_counter_fds[0] < 0) return false;
+
+    struct { uint64_t nr; uint64_t values[BENCH_COUNTERS]; } data;
+    if (read(bench_counter_fds[0], &data, sizeof(data)) != sizeof(data)) return false;
+    memcpy(values, data.values, sizeof(data.values));
+    return true;
+}
+
+static struct {
+    uint64_t ns;
+    size_t allocs;
+    uint64_t counters[BENCH_COUNTERS];
+} bench_begin;
+
+static size_t bench_allocs()
+{
+    return bench_mallocs + temp_total_allocs();
+}
+
+void bench_start()
+{
+    bench_counters_read(bench_begin.counters);
+    if (bench_counter_fds[0] >= 0) ioctl(bench_counter_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    bench_begin.allocs = bench_allocs();
+    bench_begin.ns = bench_now_ns();
+}
+
+void bench_stop(const char* name, size_t ops)
+{
+    uint64_t ns = bench_now_ns() - bench_begin.ns;
+    size_t allocs = bench_allocs() - bench_begin.allocs;
+
+    printf("%-44s %10zu ops %10.2f ns/op %8.3f allocs/op", name, ops, (double)ns / ops, (double)allocs / ops);
+
+    uint64_t counters[BENCH_COUNTERS];
+    if (bench_counters_read(counters)) {
+        for (int i = 0; i < BENCH_COUNTERS; i++) {
+            printf(" %8.2f %s", (double)(counters[i] - bench_begin.counters[i]) / ops, bench_counter_kinds[i].name);
+        }
+    }
+    printf("\n");
+}
+
+uint64_t bench_rand()
+{
+    // xorshift64*
+    static uint64_t state = 0x9e3779b97f4a7c15ull;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+int main(int argc, char** argv)
+{
+    temp_stats_enable();
+    bench_counters_open();
+
+    // With arguments only the benchmarks whose name starts with one of them run
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        bool selected = argc == 1;
+        for (int j = 1; j < argc; j++) {
+            if (strncmp(benches[i].name, argv[j], strlen(argv[j])) == 0) selected = true;
+        }
+        if (selected) benches[i].run();
+    }
+    return 0;
+}
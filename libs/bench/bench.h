@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct {
+    const char* name;
+    void (*run)();
+} bench;
+
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Measure the code between bench_start and bench_stop, which prints one
+// result line per op: time, malloc + temp_alloc allocations and, when
+// perf_event_open is allowed, cycles, instructions, cache and branch misses.
+// Measurements don't nest.
+void bench_start();
+void bench_stop(const char* name, size_t ops);
+
+// Deterministic so runs are comparable
+uint64_t bench_rand();
+
+// Keep the compiler from optimizing a result away
+#define bench_keep(value) __asm__ volatile("" : : "g"(value) : "memory")
+
+void bench_hash_table();
+void bench_hash_table_batch();
+void bench_temp_alloc();
+void bench_string();
+void bench_dynamic_array();
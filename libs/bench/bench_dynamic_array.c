@@ -0,0 +1,85 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "../dynamic_array.h"
+#include "../temp_alloc.h"
+
+#define ITEMS (1 << 22)
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    int* items;
+} Ints;
+
+void bench_dynamic_array()
+{
+    Ints ints = {0};
+
+    da_init(&ints);
+    bench_start();
+    for (int i = 0; i < ITEMS; i++) {
+        da_append(&ints, i);
+    }
+    bench_stop("dynamic_array/da_append int", ITEMS);
+    da_free(&ints);
+
+    int chunk[16] = {0};
+    da_init(&ints);
+    bench_start();
+    for (int i = 0; i < ITEMS / 16; i++) {
+        da_append_many(&ints, chunk, 16);
+    }
+    bench_stop("dynamic_array/da_append_many 16 ints", ITEMS);
+    free(ints.items);
+
+    // Prepends are O(n) each, keep the array small
+    da_init(&ints);
+    bench_start();
+    for (int i = 0; i < 4096; i++) {
+        da_prepend(&ints, i);
+    }
+    bench_stop("dynamic_array/da_prepend int (4K)", 4096);
+    free(ints.items);
+
+    // Short lists, the parser's pattern: heap arrays against small-buffer ones
+    bench_start();
+    for (int i = 0; i < ITEMS / 4; i++) {
+        da_init(&ints);
+        for (int j = 0; j < 3; j++) da_append(&ints, j);
+        bench_keep(ints.items);
+        da_free(&ints);
+    }
+    bench_stop("dynamic_array/da 3 items", ITEMS / 4);
+
+    da_small(int, 4) small;
+    bench_start();
+    for (int i = 0; i < ITEMS / 4; i++) {
+        sda_init(&small);
+        for (int j = 0; j < 3; j++) sda_append(&small, j);
+        bench_keep(small.items);
+        sda_free(&small);
+    }
+    bench_stop("dynamic_array/sda 3 items (inline)", ITEMS / 4);
+
+    temp_allocator allocator = temp_init();
+    bench_start();
+    for (int i = 0; i < ITEMS / 4; i++) {
+        temp_scope(allocator) {
+            sda_init_with_allocator(&small, temp_da_allocator(allocator));
+            for (int j = 0; j < 16; j++) sda_append(&small, j);
+            bench_keep(small.items);
+        }
+    }
+    bench_stop("dynamic_array/sda 16 items on temp_alloc", ITEMS / 4);
+    temp_uninit(allocator);
+
+    sda_init(&small);
+    for (int i = 0; i < ITEMS; i++) sda_append(&small, i);
+    bench_start();
+    while (small.count > 0) {
+        sda_swap_remove(&small, 0);
+    }
+    bench_stop("dynamic_array/sda_swap_remove with shrink", ITEMS);
+    sda_free(&small);
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "../hash_table.h"
+
+#define TABLE_CAPACITY (1 << 16)
+#define BATCH_KEYS     (1 << 22)    // 4M keys, far bigger than the caches
+#define BATCH_ROUNDS   4
+
+// `count` distinct keys padded to at least `length` characters
+static char** make_keys(size_t count, size_t length)
+{
+    char** keys = malloc(count * sizeof(char*));
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = malloc(length + 24);
+        int n = snprintf(keys[i], length + 24, "k%zu", i);
+        for (; (size_t)n < length; n++) keys[i][n] = '_';
+        keys[i][n] = '\0';
+    }
+    return keys;
+}
+
+static void free_keys(char** keys, size_t count)
+{
+    for (size_t i = 0; i < count; i++) free(keys[i]);
+    free(keys);
+}
+
+// Insert, hit, miss and delete with the table filled to a given load factor
+static void bench_load(int load_percent, size_t key_length)
+{
+    size_t count = TABLE_CAPACITY * load_percent / 100;
+    char** keys = make_keys(count * 2, key_length);  // second half never inserted
+    char name[64];
+
+    hash_table* ht = ht_init_with_capacity(TABLE_CAPACITY * 7 / 8);
+
+    snprintf(name, sizeof(name), "hash_table/insert load=%d%% key=%zu", load_percent, key_length);
+    bench_start();
+    for (size_t i = 0; i < count; i++) {
+        ht_insert(ht, keys[i], &i, sizeof(i));
+    }
+    bench_stop(name, count);
+
+    snprintf(name, sizeof(name), "hash_table/search hit load=%d%% key=%zu", load_percent, key_length);
+    bench_start();
+    for (size_t i = 0; i < count; i++) {
+        bench_keep(ht_search(ht, keys[bench_rand() % count]));
+    }
+    bench_stop(name, count);
+
+    snprintf(name, sizeof(name), "hash_table/search miss load=%d%% key=%zu", load_percent, key_length);
+    bench_start();
+    for (size_t i = 0; i < count; i++) {
+        bench_keep(ht_search(ht, keys[count + bench_rand() % count]));
+    }
+    bench_stop(name, count);
+
+    snprintf(name, sizeof(name), "hash_table/delete load=%d%% key=%zu", load_percent, key_length);
+    bench_start();
+    for (size_t i = 0; i < count; i++) {
+        ht_delete(ht, keys[i]);
+    }
+    bench_stop(name, count);
+
+    ht_free(ht);
+    free_keys(keys, count * 2);
+}
+
+void bench_hash_table()
+{
+    static const int loads[] = { 25, 50, 85 };
+    static const size_t lengths[] = { 8, 40 };   // inline and out of line keys
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t i = 0; i < sizeof(loads) / sizeof(loads[0]); i++) {
+            bench_load(loads[i], lengths[l]);
+        }
+    }
+}
+
+// Random lookups one at a time against ht_search_many on the same keys
+void bench_hash_table_batch()
+{
+    char** keys = make_keys(BATCH_KEYS, 0);
+    hash_table* ht = ht_init();
+    for (size_t i = 0; i < BATCH_KEYS; i++) {
+        ht_insert(ht, keys[i], &i, sizeof(i));
+    }
+
+    const char** order = malloc(BATCH_KEYS * sizeof(char*));
+    for (size_t i = 0; i < BATCH_KEYS; i++) {
+        order[i] = keys[bench_rand() % BATCH_KEYS];
+    }
+    void** values = malloc(BATCH_KEYS * sizeof(void*));
+
+    size_t found = 0;
+    bench_start();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        for (size_t i = 0; i < BATCH_KEYS; i++) {
+            found += ht_search(ht, order[i]) != NULL;
+        }
+    }
+    bench_stop("hash_table/search (4M keys)", BATCH_KEYS * BATCH_ROUNDS);
+
+    bench_start();
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        ht_search_many(ht, order, BATCH_KEYS, values);
+        for (size_t i = 0; i < BATCH_KEYS; i++) found += values[i] != NULL;
+    }
+    bench_stop("hash_table/search_many (4M keys)", BATCH_KEYS * BATCH_ROUNDS);
+
+    ht_free(ht);
+
+    // Inserts into a fresh table in random order
+    hash_table* one = ht_init();
+    bench_start();
+    for (size_t i = 0; i < BATCH_KEYS; i++) {
+        ht_insert(one, order[i], &i, sizeof(i));
+    }
+    bench_stop("hash_table/insert (4M keys)", BATCH_KEYS);
+    ht_free(one);
+
+    for (size_t i = 0; i < BATCH_KEYS; i++) values[i] = &found;
+    hash_table* many = ht_init();
+    bench_start();
+    ht_insert_many(many, order, values, sizeof(found), BATCH_KEYS);
+    bench_stop("hash_table/insert_many (4M keys)", BATCH_KEYS);
+    ht_free(many);
+
+    if (found != 2 * BATCH_KEYS * BATCH_ROUNDS) printf("hash_table_batch: lookups missed\n");
+
+    free(values);
+    free(order);
+    free_keys(keys, BATCH_KEYS);
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "../string.h"
+
+#define FIELDS 64
+#define ROUNDS (1 << 14)
+
+void bench_string()
+{
+    string_builder line = sb_init(NULL);
+    for (int i = 0; i < FIELDS; i++) {
+        sb_add_f(&line, "%sfield_%d", i ? "," : "", i * 7919);
+    }
+    string_view csv = sb_to_sv(&line);
+
+    // A line of source with the token at the very end, as sv_in_sv and the
+    // lexer's comment scan see it
+    string_builder source = sb_init(NULL);
+    for (int i = 0; i < 15; i++) sb_add_cstr(&source, "var value = other + 12; ");
+    sb_add_cstr(&source, "// comment");
+    string_view text = sb_to_sv(&source);
+
+    static const char* levels[] = { "scalar", "sse2", "avx2" };
+    char name[64];
+
+    for (sv_kernel_level level = SV_KERNEL_SCALAR; level <= SV_KERNEL_AVX2; level++) {
+        if (sv_kernel_set(level) != level) break;
+
+        bench_start();
+        for (size_t r = 0; r < ROUNDS; r++) {
+            string_view rest = csv;
+            while (rest.count > 0) {
+                bench_keep(sv_split_c(&rest, ',').count);
+            }
+        }
+        snprintf(name, sizeof(name), "string/sv_split_c (64 fields, %s)", levels[level]);
+        bench_stop(name, ROUNDS * FIELDS);
+
+        bench_start();
+        for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+            bench_keep(sv_find_sv(text, sv_from_cstr("//")));
+        }
+        snprintf(name, sizeof(name), "string/sv_find_sv (%zu chars, %s)", text.count, levels[level]);
+        bench_stop(name, ROUNDS * FIELDS);
+
+        string_view a = sv_from_cstr("some_identifier_name_that_is_long");
+        string_view b = sv_from_cstr("some_identifier_name_that_is_lonG");
+        bench_start();
+        for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+            bench_keep(sv_equal(a, b));
+        }
+        snprintf(name, sizeof(name), "string/sv_equal (33 chars, %s)", levels[level]);
+        bench_stop(name, ROUNDS * FIELDS);
+
+        bench_start();
+        for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+            bench_keep(sv_trim(sv_from_cstr("   padded   ")).count);
+        }
+        snprintf(name, sizeof(name), "string/sv_trim (%s)", levels[level]);
+        bench_stop(name, ROUNDS * FIELDS);
+    }
+    sv_kernel_set(SV_KERNEL_AVX2);
+
+    string_view number = sv_from_cstr("1234567890123456");
+    bench_start();
+    for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+        bench_keep(sv_to_digit_scalar(number));
+    }
+    bench_stop("string/sv_to_digit (16 digits, scalar)", ROUNDS * FIELDS);
+
+    bench_start();
+    for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+        bench_keep(sv_to_digit(number));
+    }
+    bench_stop("string/sv_to_digit (16 digits, swar)", ROUNDS * FIELDS);
+
+    string_builder sb = sb_init(NULL);
+    bench_start();
+    for (size_t r = 0; r < ROUNDS * FIELDS; r++) {
+        sb_add_f(&sb, "%zu:%s ", r, "x");
+    }
+    bench_stop("string/sb_add_f", ROUNDS * FIELDS);
+
+    // 16MB of report lines, fresh builders so growth is part of the cost
+    string_view report_line = sv_from_cstr("temp_alloc: parser     live 1048576 peak 2097152 reserved 4194304\n");
+    size_t lines = (16 << 20) / report_line.count;
+
+    string_builder report = {0};
+    bench_start();
+    for (size_t r = 0; r < lines; r++) {
+        sb_add(&report, report_line);
+    }
+    bench_stop("string/sb_add (16MB report)", lines);
+
+    string_chunks chunks = sc_init();
+    bench_start();
+    for (size_t r = 0; r < lines; r++) {
+        sc_add(&chunks, report_line);
+    }
+    bench_stop("string/sc_add (16MB report)", lines);
+
+    FILE* null = fopen("/dev/null", "w");
+    if (null != NULL) {
+        bench_start();
+        fwrite(report.items, 1, report.count, null);
+        fflush(null);
+        bench_stop("string/fwrite (16MB report)", 1);
+
+        bench_start();
+        bench_keep(sc_write_fp(&chunks, null));
+        bench_stop("string/sc_write (16MB report)", 1);
+        fclose(null);
+    }
+
+    sc_free(&chunks);
+    sb_free(&report);
+
+    sb_free(&sb);
+    sb_free(&source);
+    sb_free(&line);
+}
@@ -0,0 +1,67 @@
+#include "bench.h"
+#include "../temp_alloc.h"
+
+#define ALLOCS   (1 << 20)
+#define REALLOCS (1 << 16)
+
+void bench_temp_alloc()
+{
+    temp_allocator allocator = temp_init();
+    temp_set_name(allocator, "bench");
+
+    // Many small blocks, released together
+    bench_start();
+    for (size_t i = 0; i < ALLOCS; i++) {
+        bench_keep(temp_alloc(allocator, 32));
+    }
+    temp_reset(allocator);
+    bench_stop("temp_alloc/bump 32B + reset", ALLOCS);
+
+    // Short-lived blocks freed right away
+    bench_start();
+    for (size_t i = 0; i < ALLOCS; i++) {
+        void* p = temp_alloc(allocator, 64);
+        bench_keep(p);
+        temp_free(p);
+    }
+    bench_stop("temp_alloc/alloc+free 64B", ALLOCS);
+
+    // Mixed sizes with random frees, exercising the size bins
+    static void* live[1024];
+    bench_start();
+    for (size_t i = 0; i < ALLOCS; i++) {
+        size_t slot = bench_rand() % 1024;
+        if (live[slot] != NULL) temp_free(live[slot]);
+        live[slot] = temp_alloc(allocator, 16 + bench_rand() % 496);
+    }
+    bench_stop("temp_alloc/random 16-512B, random free", ALLOCS);
+    temp_reset(allocator);
+
+    // Scoped temporaries, the interpreter's per-statement pattern
+    bench_start();
+    for (size_t i = 0; i < ALLOCS / 8; i++) {
+        temp_scope(allocator) {
+            for (int j = 0; j < 8; j++) bench_keep(temp_alloc(allocator, 48));
+        }
+    }
+    bench_stop("temp_alloc/8 allocs per temp_scope", ALLOCS);
+
+    // Growing one buffer a little at a time, up to 1MB
+    bench_start();
+    void* buffer = NULL;
+    for (size_t size = 16; size <= REALLOCS * 16; size += 16) {
+        buffer = temp_realloc(allocator, buffer, size);
+    }
+    bench_stop("temp_realloc/grow by 16B", REALLOCS);
+
+    // Large blocks that bypass the chunks
+    bench_start();
+    for (size_t i = 0; i < 1024; i++) {
+        void* p = temp_alloc(allocator, 64 * 1024);
+        bench_keep(p);
+        temp_free(p);
+    }
+    bench_stop("temp_alloc/alloc+free 64KB (large)", 1024);
+
+    temp_uninit(allocator);
+}
@@ -107,28 +107,192 @@
     } while (0)
 
 
-#define da_delete_range(da, start_index, end_index)                                                                             \
-    do {                                                                                                                        \
-        if ((da)->count > start_index && (da)->count > end_index) {                                                             \
-            (da)->count -= (end_index - start_index);                                                                           \
-            (da)->capacity -= (end_index - start_index);                                                                        \
-            memmove(&(da)->items[start_index], &(da)->items[end_index], ((da)->capacity - start_index) * sizeof(*(da)->items)); \
-            (da)->items = (typeof((da)->items))DA_REALLOC((da)->items, ((da)->capacity) * sizeof(*(da)->items));                \
-        }                                                                                                                       \
+// Halve the capacity once the array is a quarter full, so a run of removals
+// costs O(1) amortized like a run of appends
+#define da_shrink(da)                                                                                       \
+    do {                                                                                                    \
+        if ((da)->capacity > 1 && (da)->count <= (da)->capacity / 4) {                                      \
+            (da)->capacity /= 2;                                                                            \
+            (da)->items = (typeof((da)->items))DA_REALLOC((da)->items, (da)->capacity * sizeof(*(da)->items)); \
+            DA_ASSERT((da)->items != NULL && "Failed to allocate memory");                                  \
+        }                                                                                                   \
     } while (0)
 
-#define da_delete(da, index)                                                                                        \
-    do {                                                                                                            \
-        if ((da)->count > index) {                                                                                  \
-            (da)->count--;                                                                                          \
-            (da)->capacity--;                                                                                       \
-            memmove(&(da)->items[index], &(da)->items[index + 1], ((da)->capacity - index) * sizeof(*(da)->items)); \
-            (da)->items = (typeof((da)->items))DA_REALLOC((da)->items, ((da)->capacity) * sizeof(*(da)->items));    \
-        }                                                                                                           \
+#define da_delete_range(da, start_index, end_index)                                                                     \
+    do {                                                                                                                \
+        if ((da)->count > start_index && (da)->count > end_index) {                                                     \
+            memmove(&(da)->items[start_index], &(da)->items[end_index], ((da)->count - (end_index)) * sizeof(*(da)->items)); \
+            (da)->count -= (end_index - start_index);                                                                   \
+            da_shrink(da);                                                                                              \
+        }                                                                                                               \
+    } while (0)
+
+#define da_delete(da, index)                                                                                          \
+    do {                                                                                                              \
+        if ((da)->count > index) {                                                                                    \
+            memmove(&(da)->items[index], &(da)->items[index + 1], ((da)->count - (index) - 1) * sizeof(*(da)->items)); \
+            (da)->count--;                                                                                            \
+            da_shrink(da);                                                                                            \
+        }                                                                                                             \
+    } while (0)
+
+// Remove an item by moving the last one into its place, order is not kept
+#define da_swap_remove(da, index)                               \
+    do {                                                        \
+        if ((da)->count > index) {                              \
+            (da)->items[index] = (da)->items[--(da)->count];    \
+            da_shrink(da);                                      \
+        }                                                       \
+    } while (0)
+
+#define da_clear(da)        \
+    do {                    \
+        (da)->count = 0;    \
+    } while (0)
+
+//
+// Small-buffer arrays: the first N items live inside the array struct, so
+// short arrays never allocate. Past that the items move to the heap, or to
+// the array's da_allocator when it has one (see temp_da_allocator in
+// temp_alloc.h). `items` may point into the struct itself, so never copy a
+// small array by value, pass it by pointer.
+//
+//     typedef da_small(struct Expr*, 4) Exprs;
+//     Exprs exprs;
+//     sda_init(&exprs);
+//     sda_append(&exprs, expr);
+//     sda_free(&exprs);
+//
+typedef struct {
+    void* (*realloc)(void* context, void* ptr, size_t size);
+    void (*free)(void* context, void* ptr);
+    void* context;
+} da_allocator;
+
+static inline void* da_allocator_realloc(da_allocator* allocator, void* ptr, size_t size)
+{
+    if (allocator->realloc != NULL) return allocator->realloc(allocator->context, ptr, size);
+    return DA_REALLOC(ptr, size);
+}
+
+static inline void da_allocator_free(da_allocator* allocator, void* ptr)
+{
+    if (allocator->free != NULL) {
+        allocator->free(allocator->context, ptr);
+    } else {
+        DA_FREE(ptr);
+    }
+}
+
+#define da_small(type, n)           \
+    struct {                        \
+        size_t count;               \
+        size_t capacity;            \
+        type* items;                \
+        da_allocator allocator;     \
+        type inline_items[n];       \
+    }
+
+#define sda_inline_capacity(da) arr_count((da)->inline_items)
+#define sda_is_inline(da)       ((da)->items == (da)->inline_items)
+
+#define sda_init_with_allocator(da, alloc)              \
+    do {                                                \
+        (da)->count = 0;                                \
+        (da)->capacity = sda_inline_capacity(da);       \
+        (da)->items = (da)->inline_items;               \
+        (da)->allocator = (alloc);                      \
+    } while (0)
+
+#define sda_init(da) sda_init_with_allocator(da, (da_allocator){0})
+
+// Move the items to a buffer of `new_capacity`, back inline when they fit
+#define sda_set_capacity(da, new_capacity)                                                              \
+    do {                                                                                                \
+        size_t _capacity = (new_capacity);                                                              \
+        if (_capacity <= sda_inline_capacity(da)) {                                                     \
+            if (!sda_is_inline(da)) {                                                                   \
+                memcpy((da)->inline_items, (da)->items, (da)->count * sizeof(*(da)->items));            \
+                da_allocator_free(&(da)->allocator, (da)->items);                                       \
+                (da)->items = (da)->inline_items;                                                       \
+            }                                                                                           \
+            (da)->capacity = sda_inline_capacity(da);                                                   \
+        } else if (sda_is_inline(da)) {                                                                 \
+            typeof((da)->items) _items = da_allocator_realloc(&(da)->allocator, NULL,                   \
+                                                              _capacity * sizeof(*(da)->items));        \
+            DA_ASSERT(_items != NULL && "Failed to allocate memory");                                   \
+            memcpy(_items, (da)->inline_items, (da)->count * sizeof(*(da)->items));                     \
+            (da)->items = _items;                                                                       \
+            (da)->capacity = _capacity;                                                                 \
+        } else {                                                                                        \
+            (da)->items = da_allocator_realloc(&(da)->allocator, (da)->items,                           \
+                                               _capacity * sizeof(*(da)->items));                       \
+            DA_ASSERT((da)->items != NULL && "Failed to allocate memory");                              \
+            (da)->capacity = _capacity;                                                                 \
+        }                                                                                               \
+    } while (0)
+
+#define sda_reserve(da, n)                                      \
+    do {                                                        \
+        if ((size_t)(n) > (da)->capacity) {                     \
+            size_t _new_capacity = (da)->capacity * 2;          \
+            while (_new_capacity < (size_t)(n)) {               \
+                _new_capacity *= 2;                             \
+            }                                                   \
+            sda_set_capacity(da, _new_capacity);                \
+        }                                                       \
+    } while (0)
+
+#define sda_append(da, item)                        \
+    do {                                            \
+        sda_reserve(da, (da)->count + 1);           \
+        (da)->items[(da)->count++] = (item);        \
+    } while (0)
+
+#define sda_append_many(da, new_items, new_items_count)                                             \
+    do {                                                                                            \
+        sda_reserve(da, (da)->count + (new_items_count));                                           \
+        memcpy((da)->items + (da)->count, (new_items), (new_items_count) * sizeof(*(da)->items));   \
+        (da)->count += (new_items_count);                                                           \
+    } while (0)
+
+#define sda_shrink(da)                                                                          \
+    do {                                                                                        \
+        if ((da)->capacity > sda_inline_capacity(da) && (da)->count <= (da)->capacity / 4) {    \
+            sda_set_capacity(da, (da)->capacity / 2);                                           \
+        }                                                                                       \
+    } while (0)
+
+#define sda_delete(da, index)                                                                                         \
+    do {                                                                                                              \
+        if ((da)->count > index) {                                                                                    \
+            memmove(&(da)->items[index], &(da)->items[index + 1], ((da)->count - (index) - 1) * sizeof(*(da)->items)); \
+            (da)->count--;                                                                                            \
+            sda_shrink(da);                                                                                           \
+        }                                                                                                             \
+    } while (0)
+
+#define sda_swap_remove(da, index)                              \
+    do {                                                        \
+        if ((da)->count > index) {                              \
+            (da)->items[index] = (da)->items[--(da)->count];    \
+            sda_shrink(da);                                     \
+        }                                                       \
+    } while (0)
+
+#define sda_clear(da)       \
+    do {                    \
+        (da)->count = 0;    \
     } while (0)
 
-#define da_clear(da)                               \
-    do {                                           \
-        da_delete_range(da, 0, ((da)->count - 1)); \
-        (da)->count = 0;                           \
+#define sda_free(da)                                                \
+    do {                                                            \
+        if ((da) != NULL) {                                         \
+            if (!sda_is_inline(da)) {                               \
+                da_allocator_free(&(da)->allocator, (da)->items);   \
+            }                                                       \
+            (da)->items = (da)->inline_items;                       \
+            (da)->capacity = sda_inline_capacity(da);               \
+            (da)->count = 0;                                        \
+        }                                                           \
     } while (0)
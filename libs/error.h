@@ -27,7 +27,7 @@ struct Error {
 };
 
 #define _error_f(_type, fmt, ...) ({ \
-    static struct Error e; \
+    static _Thread_local struct Error e; \
     e.type = _type; \
     snprintf(e.message, MAX_ERROR_MSG, fmt, __VA_ARGS__); \
     e.trace_index = 0; \
@@ -38,7 +38,7 @@ struct Error {
 #define error_f_type(type, fmt, ...) _error_f(type, fmt, __VA_ARGS__)
 
 #define _error(_type, _message)({ \
-    static struct Error e; \
+    static _Thread_local struct Error e; \
     e.type = _type; \
     unsigned long n = strlen(_message); \
     memcpy(e.message, _message, n - 1);\
@@ -4,15 +4,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#define PRIME_IMPLEMENTATION
-#include "prime.h"
 #include "hash_table.h"
-
-// Specific prime number for reduce collisions 
-#define HT_INITIAL_BASE_SIZE 53
-
-void ht_resize_up(hash_table* ht);
-void ht_resize_down(hash_table* ht);
+#include "hash_table_typed.h"
+#include "symbol.h"
+
+#define HT_MIN_CAPACITY HT_GROUP_WIDTH
+// Old slots moved by each insert or delete while a resize is in progress.
+// A table that just grew has room for as many inserts as it had slots, so
+// migration always finishes long before the next resize is due.
+#define HT_MIGRATE_STEP 64
+// Keys hashed and prefetched ahead of being resolved by the *_many functions
+#define HT_BATCH_SIZE 16
+
+#define ht_slot_at(ht, i)  ((ht_slot*)((ht)->slots + (i) * (ht)->slot_size))
+#define ht_slot_value(s)   ((void*)((uint8_t*)(s) + sizeof(ht_slot)))
+#define ht_value_slot(v)   ((ht_slot*)((uint8_t*)(v) - sizeof(ht_slot)))
+#define ht_slot_key(s)     ((s)->key_len < HT_INLINE_KEY_SIZE ? (s)->key_inline : (s)->key)
 
 void ht_to_char(char* cstr, void* data, int data_size)
 {
@@ -25,218 +32,606 @@ void ht_to_char(char* cstr, void* data, int data_size)
 }
 
 //
-// Hash formula:
-//      h_b(<a_0, a_1, ..., a_(n-1)>) = (SUM_{j=0 to n-1} (a_j * b^j)) mod p
+// Hash: 8 bytes at a time, each word folded in with a 64x64->128 bit multiply
+// whose halves are xored together (the mixing step of wyhash)
 //
-size_t ht_hash(const char* s, const int a, const int m)
+#define HT_SEED 0xa0761d6478bd642full
+#define HT_K1   0xe7037ed1a0b428dbull
+#define HT_K2   0x8ebc6af09c88c6e3ull
+
+static inline uint64_t ht_mix(uint64_t a, uint64_t b)
 {
-    unsigned long hash = 0;
-    unsigned long a_pow = 1;  // a^0 = 1
-    size_t len_s = strlen(s);
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
 
-    for (size_t i = 0; i < len_s; i++) {
-        hash += s[len_s - (i + 1)] * a_pow;
-        hash = hash % m;
-        a_pow = (a_pow * a) % m;  // Compute a^(i+1) % m
+uint64_t ht_hash(const char* s, size_t len)
+{
+    uint64_t hash = HT_SEED ^ len;
+
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, s, 8);
+        hash = ht_mix(hash ^ word, HT_K1);
+        s += 8;
+        len -= 8;
     }
 
-    return hash;
+    uint64_t tail = 0;
+    memcpy(&tail, s, len);
+    return ht_mix(hash ^ tail, HT_K2);
 }
 
+static void ht_set_ctrl(hash_table* ht, size_t index, uint8_t c)
+{
+    ht_ctrl_set(ht->ctrl, ht->capacity, index, c);
+}
 
-//
-// Double hashing:
-//      h(k, i) = (h_1(k) + i * h_2(k)) mod m
-//      h_1(k) = k mod m
-//      h_2(k) = m' - (k % m')
-//
-#define HT_PRIME_1 31
-#define HT_PRIME_2 37
+// A lookup key: a C string hashed once up front, or an interned symbol that
+// already carries its hash and is compared by pointer
+typedef struct {
+    const char* data;
+    size_t len;
+    uint64_t hash;
+    const symbol* symbol;
+} ht_key;
+
+static ht_key ht_key_cstr(const char* key)
+{
+    size_t len = strlen(key);
+    return (ht_key){ .data = key, .len = len, .hash = ht_hash(key, len) };
+}
 
-size_t ht_get_hash(const char* s, const size_t num_buckets, const size_t attempt)
+static ht_key ht_key_symbol(const symbol* key)
 {
-    size_t hash_a = ht_hash(s, HT_PRIME_1, num_buckets);
-    size_t hash_b = ht_hash(s, HT_PRIME_2, num_buckets - 2); // m' = num_buckets - 2
-    hash_b = (num_buckets - 1) - hash_b;  // Ensure non-zero secondary hash
-    return (hash_a + attempt * hash_b) % num_buckets;
+    return (ht_key){ .data = key->name, .len = key->len, .hash = key->hash, .symbol = key };
 }
 
+static inline bool ht_slot_matches(hash_table* ht, ht_slot* slot, ht_key key)
+{
+    if (ht->symbol_keys) return slot->symbol == key.symbol;
+    return slot->hash == key.hash && slot->key_len == key.len &&
+           memcmp(ht_slot_key(slot), key.data, key.len) == 0;
+}
 
-ht_item* ht_new_item(hash_table* ht, const char* k, void* v, int value_size)
+static size_t ht_find_index(hash_table* ht, ht_key key)
 {
-    ht_item* i = temp_alloc(ht->allocator, sizeof(ht_item));
-    if (!i) {
-        perror("Failed to allocate memory for ht_item");
-        exit(EXIT_FAILURE);
+    size_t mask = ht->capacity - 1;
+    size_t pos = HT_H1(key.hash) & mask;
+    uint8_t h2 = HT_H2(key.hash);
+
+    for (size_t step = HT_GROUP_WIDTH;; step += HT_GROUP_WIDTH) {
+        const uint8_t* group = ht->ctrl + pos;
+
+        uint32_t match = ht_group_match(group, h2);
+        while (match != 0) {
+            size_t index = (pos + __builtin_ctz(match)) & mask;
+            if (ht_slot_matches(ht, ht_slot_at(ht, index), key)) {
+                return index;
+            }
+            match &= match - 1;
+        }
+
+        if (ht_group_match_empty(group) != 0) return ht->capacity;
+        pos = (pos + step) & mask;
     }
+}
+
+// First EMPTY or DELETED slot on the probe sequence of `hash`
+static size_t ht_find_free(hash_table* ht, uint64_t hash)
+{
+    return ht_ctrl_find_free(ht->ctrl, ht->capacity, hash);
+}
 
-    i->key = temp_strdup(ht->allocator, k);  // Duplicate the key
-    if (!i->key) {
-        perror("Failed to allocate memory for key");
-        temp_free(i);
+static void ht_alloc_arrays(hash_table* ht, size_t capacity, size_t value_stride)
+{
+    ht->capacity = capacity;
+    ht->value_stride = value_stride;
+    ht->slot_size = sizeof(ht_slot) + value_stride;
+    ht->growth_left = ht_max_load(capacity);
+
+    ht->ctrl = temp_alloc(ht->allocator, capacity + HT_GROUP_WIDTH);
+    if (!ht->ctrl) {
+        perror("Failed to allocate memory for hash table");
         exit(EXIT_FAILURE);
     }
+    memset(ht->ctrl, HT_CTRL_EMPTY, capacity + HT_GROUP_WIDTH);
+
+    ht->slots = NULL;
+    if (value_stride > 0) {
+        ht->slots = temp_alloc(ht->allocator, capacity * ht->slot_size);
+        if (!ht->slots) {
+            perror("Failed to allocate memory for hash table");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
 
-    i->value = temp_alloc(ht->allocator, value_size);
-    if (!i->value) {
-        perror("Failed to allocate memory for value");
-        temp_free(i);
-        temp_free(i->key);
-        exit(EXIT_FAILURE);
+// Move every live slot into fresh arrays, dropping tombstones on the way.
+// Slots move whole, so long keys keep their allocation.
+static void ht_rehash(hash_table* ht, size_t capacity, size_t value_stride)
+{
+    hash_table old = *ht;
+    ht_alloc_arrays(ht, capacity, value_stride);
+
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] & 0x80) continue;
+
+        ht_slot* from = ht_slot_at(&old, i);
+        size_t index = ht_find_free(ht, from->hash);
+        ht_set_ctrl(ht, index, HT_H2(from->hash));
+        memcpy(ht_slot_at(ht, index), from, sizeof(ht_slot) + from->value_size);
+        ht->growth_left--;
     }
 
-    memcpy(i->value, v, value_size);
-    i->value_size = value_size;
-    return i;
+    temp_free(old.ctrl);
+    if (old.slots) temp_free(old.slots);
 }
 
-hash_table* ht_init_with_capacity(const int base_capacity)
+// The arrays being migrated from, viewed as a table of their own
+static hash_table ht_old_view(hash_table* ht)
+{
+    return (hash_table){
+        .capacity = ht->old_capacity,
+        .ctrl = ht->old_ctrl,
+        .slots = ht->old_slots,
+        .slot_size = ht->old_slot_size,
+        .symbol_keys = ht->symbol_keys,
+    };
+}
+
+static void ht_migrate_slot(hash_table* ht, hash_table* old, size_t i)
+{
+    ht_slot* from = ht_slot_at(old, i);
+    size_t index = ht_find_free(ht, from->hash);
+    if (ht->ctrl[index] == HT_CTRL_EMPTY) {
+        ht->growth_left--;
+    }
+    ht_set_ctrl(ht, index, HT_H2(from->hash));
+    memcpy(ht_slot_at(ht, index), from, sizeof(ht_slot) + from->value_size);
+
+    // DELETED keeps the probe sequences of the remaining old keys intact
+    ht_set_ctrl(old, i, HT_CTRL_DELETED);
+}
+
+static void ht_migrate(hash_table* ht, size_t steps)
+{
+    if (ht->old_ctrl == NULL) return;
+
+    hash_table old = ht_old_view(ht);
+    for (; steps > 0 && ht->migrate_pos < old.capacity; steps--, ht->migrate_pos++) {
+        if (!(old.ctrl[ht->migrate_pos] & 0x80)) {
+            ht_migrate_slot(ht, &old, ht->migrate_pos);
+        }
+    }
+
+    if (ht->migrate_pos == old.capacity) {
+        temp_free(ht->old_ctrl);
+        if (ht->old_slots) temp_free(ht->old_slots);
+        ht->old_ctrl = NULL;
+        ht->old_slots = NULL;
+    }
+}
+
+// Switch to fresh arrays of `capacity` slots and leave the live slots to be
+// moved over by the following inserts and deletes
+static void ht_start_resize(hash_table* ht, size_t capacity)
+{
+    ht_migrate(ht, SIZE_MAX);
+
+    ht->old_ctrl = ht->ctrl;
+    ht->old_slots = ht->slots;
+    ht->old_capacity = ht->capacity;
+    ht->old_slot_size = ht->slot_size;
+    ht->migrate_pos = 0;
+
+    ht_alloc_arrays(ht, capacity, ht->value_stride);
+}
+
+static size_t ht_capacity_for(size_t count)
+{
+    size_t capacity = HT_MIN_CAPACITY;
+    while (ht_max_load(capacity) < count) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static hash_table* ht_init_in(temp_allocator allocator, bool owns_allocator, const int base_capacity)
 {
-    temp_allocator allocator = temp_init();
     hash_table* ht = temp_alloc(allocator, sizeof(hash_table));
+    if (!ht) {
+        perror("Failed to allocate memory for hash table");
+        exit(EXIT_FAILURE);
+    }
 
     ht->allocator = allocator;
-    ht->base_capacity = base_capacity;
-    ht->capacity = next_prime(ht->base_capacity);
-
+    ht->owns_allocator = owns_allocator;
     ht->count = 0;
-    ht->items = temp_alloc(ht->allocator, (size_t)ht->capacity * sizeof(ht_item*));
+    ht->symbol_keys = false;
+    ht->old_ctrl = NULL;
+    ht->old_slots = NULL;
+
+    // Slots are allocated by the first insert, once the value size is known
+    ht_alloc_arrays(ht, ht_capacity_for(base_capacity > 0 ? base_capacity : 0), 0);
     return ht;
 }
 
+hash_table* ht_init_with_capacity(const int base_capacity)
+{
+    temp_allocator allocator = temp_init();
+    temp_set_name(allocator, "hash_table");
+    return ht_init_in(allocator, true, base_capacity);
+}
+
 hash_table* ht_init()
 {
-    return ht_init_with_capacity(HT_INITIAL_BASE_SIZE);
+    return ht_init_with_capacity(HT_MIN_CAPACITY);
 }
 
-void ht_del_item(ht_item* i)
+hash_table* ht_init_symbols(const int base_capacity)
 {
-    temp_free(i->value);
-    temp_free(i->key);
-    temp_free(i);
+    hash_table* ht = ht_init_with_capacity(base_capacity);
+    ht->symbol_keys = true;
+    return ht;
 }
 
-ht_item HT_DELETED_ITEM = {NULL, NULL, 0};
+hash_table* ht_init_symbols_with_allocator(temp_allocator allocator, const int base_capacity)
+{
+    hash_table* ht = ht_init_in(allocator, false, base_capacity);
+    ht->symbol_keys = true;
+    return ht;
+}
 
 void ht_free(hash_table* ht)
 {
-    for (int i = 0; i < ht->capacity; i++) {
-        ht_item* item = ht->items[i];
-        if (item != NULL && item != &HT_DELETED_ITEM) {
-            ht_del_item(item);
-        }
+    // Long keys are the only per-item allocations, the rest goes with the allocator
+    if (ht->owns_allocator) {
+        temp_uninit(ht->allocator);
+        return;
     }
-    temp_free(ht->items);
-    temp_free(ht);
 
-    temp_uninit(ht->allocator);
+    // Borrowed allocators only hold symbol tables, which never copy keys
+    temp_free(ht->ctrl);
+    if (ht->slots) temp_free(ht->slots);
+    if (ht->old_ctrl) temp_free(ht->old_ctrl);
+    if (ht->old_slots) temp_free(ht->old_slots);
+    temp_free(ht);
 }
 
-void ht_insert(hash_table* ht, const char* key, void* value, int value_size)
+static void ht_fill_slot(hash_table* ht, size_t index, ht_key key)
 {
-    int load = ht->count * 100 / ht->capacity;
-    if (load > 70) {
-        ht_resize_up(ht);
-    }
-
-    ht_item* new_item = ht_new_item(ht, key, value, value_size);
-    int index = ht_get_hash(new_item->key, ht->capacity, 0);
-    ht_item* cur_item = ht->items[index];
-    int i = 1;
-    while (cur_item != NULL && cur_item != &HT_DELETED_ITEM) {
-        index = ht_get_hash(new_item->key, ht->capacity, i);
-        cur_item = ht->items[index];
-        i++;
-    } 
-    ht->items[index] = new_item;
+    if (ht->ctrl[index] == HT_CTRL_EMPTY) {
+        ht->growth_left--;
+    }
+    ht_set_ctrl(ht, index, HT_H2(key.hash));
+
+    ht_slot* slot = ht_slot_at(ht, index);
+    slot->hash = key.hash;
+    slot->key_len = key.len;
+    if (ht->symbol_keys) {
+        slot->symbol = key.symbol;
+    } else if (key.len < HT_INLINE_KEY_SIZE) {
+        memcpy(slot->key_inline, key.data, key.len + 1);
+    } else {
+        slot->key = temp_strdup(ht->allocator, key.data);
+        if (!slot->key) {
+            perror("Failed to allocate memory for key");
+            exit(EXIT_FAILURE);
+        }
+    }
     ht->count++;
 }
 
-void* ht_search(hash_table* ht, const char* key)
+static void* ht_get_or_insert_key(hash_table* ht, ht_key key, int value_size, bool* inserted)
 {
-    int index = ht_get_hash(key, ht->capacity, 0);
-    ht_item* item = ht->items[index];
-    int i = 1;
+    size_t stride = ((size_t)value_size + 15) & ~(size_t)15;
+    if (stride > ht->value_stride) {
+        // Slots get bigger, rare enough to do all at once
+        ht_migrate(ht, SIZE_MAX);
+        ht_rehash(ht, ht->capacity, stride);
+    }
+
+    if (ht->old_ctrl) {
+        ht_migrate(ht, HT_MIGRATE_STEP);
+    }
+    if (ht->old_ctrl) {
+        // Pull the key over first so the probe below finds it
+        hash_table old = ht_old_view(ht);
+        size_t i = ht_find_index(&old, key);
+        if (i != old.capacity) ht_migrate_slot(ht, &old, i);
+    }
 
-    while (item != NULL) {
-        if (item != &HT_DELETED_ITEM) {
-            if (strcmp(item->key, key) == 0) {
-                return item->value;
+    // Look the key up and remember the first free slot on the way, so a
+    // missing key is placed without probing again
+    size_t mask = ht->capacity - 1;
+    size_t pos = HT_H1(key.hash) & mask;
+    uint8_t h2 = HT_H2(key.hash);
+    size_t index = ht->capacity;
+
+    for (size_t step = HT_GROUP_WIDTH;; step += HT_GROUP_WIDTH) {
+        const uint8_t* group = ht->ctrl + pos;
+
+        uint32_t match = ht_group_match(group, h2);
+        while (match != 0) {
+            ht_slot* slot = ht_slot_at(ht, (pos + __builtin_ctz(match)) & mask);
+            if (ht_slot_matches(ht, slot, key)) {
+                if (inserted) *inserted = false;
+                return ht_slot_value(slot);
             }
+            match &= match - 1;
         }
-        index = ht_get_hash(key, ht->capacity, i);
-        item = ht->items[index];
-        i++;
+
+        uint32_t free_mask = ht_group_match_free(group);
+        if (index == ht->capacity && free_mask != 0) {
+            index = (pos + __builtin_ctz(free_mask)) & mask;
+        }
+
+        if (ht_group_match_empty(group) != 0) break;
+        pos = (pos + step) & mask;
+    }
+
+    // Reusing a tombstone costs no growth, taking an EMPTY slot may rehash
+    if (ht->ctrl[index] == HT_CTRL_EMPTY && ht->growth_left == 0) {
+        // Mostly tombstones: clean them up in place, otherwise grow
+        size_t capacity = ht->count * 2 < ht_max_load(ht->capacity) ? ht->capacity : ht->capacity * 2;
+        ht_start_resize(ht, capacity);
+        index = ht_find_free(ht, key.hash);
+    }
+
+    ht_fill_slot(ht, index, key);
+
+    ht_slot* slot = ht_slot_at(ht, index);
+    slot->value_size = value_size;
+    memset(ht_slot_value(slot), 0, value_size);
+    if (inserted) *inserted = true;
+    return ht_slot_value(slot);
+}
+
+static void* ht_upsert_key(hash_table* ht, ht_key key, void* value, int value_size)
+{
+    void* slot_value = ht_get_or_insert_key(ht, key, value_size, NULL);
+    memcpy(slot_value, value, value_size);
+    ht_value_slot(slot_value)->value_size = value_size;
+    return slot_value;
+}
+
+static void* ht_find_key(hash_table* ht, ht_key key)
+{
+    size_t index = ht_find_index(ht, key);
+    if (index != ht->capacity) return ht_slot_value(ht_slot_at(ht, index));
+
+    if (ht->old_ctrl) {
+        hash_table old = ht_old_view(ht);
+        index = ht_find_index(&old, key);
+        if (index != old.capacity) return ht_slot_value(ht_slot_at(&old, index));
     }
     return NULL;
 }
 
+static void ht_delete_key(hash_table* ht, ht_key key)
+{
+    if (ht->old_ctrl) {
+        ht_migrate(ht, HT_MIGRATE_STEP);
+    }
+    if (ht->old_ctrl) {
+        hash_table old = ht_old_view(ht);
+        size_t i = ht_find_index(&old, key);
+        if (i != old.capacity) ht_migrate_slot(ht, &old, i);
+    }
+
+    size_t index = ht_find_index(ht, key);
+    if (index == ht->capacity) return;
+
+    ht_slot* slot = ht_slot_at(ht, index);
+    if (!ht->symbol_keys && slot->key_len >= HT_INLINE_KEY_SIZE) {
+        temp_free(slot->key);
+    }
+
+    if (ht_ctrl_erase(ht->ctrl, ht->capacity, index)) {
+        ht->growth_left++;
+    }
+    ht->count--;
+
+    if (ht->capacity > HT_MIN_CAPACITY && ht->count * 10 < ht->capacity && ht->old_ctrl == NULL) {
+        ht_start_resize(ht, ht->capacity / 2);
+    }
+}
+
+void* ht_get_or_insert(hash_table* ht, const char* key, int value_size, bool* inserted)
+{
+    return ht_get_or_insert_key(ht, ht_key_cstr(key), value_size, inserted);
+}
+
+void* ht_upsert(hash_table* ht, const char* key, void* value, int value_size)
+{
+    return ht_upsert_key(ht, ht_key_cstr(key), value, value_size);
+}
+
+void ht_insert(hash_table* ht, const char* key, void* value, int value_size)
+{
+    ht_upsert_key(ht, ht_key_cstr(key), value, value_size);
+}
+
+void* ht_find_slot(hash_table* ht, const char* key)
+{
+    return ht_find_key(ht, ht_key_cstr(key));
+}
+
+void* ht_search(hash_table* ht, const char* key)
+{
+    return ht_find_key(ht, ht_key_cstr(key));
+}
+
 bool ht_has(hash_table* ht, const char* key)
 {
-    void* value = ht_search(ht, key);
-    return value != NULL;
+    return ht_find_key(ht, ht_key_cstr(key)) != NULL;
 }
 
 void ht_delete(hash_table* ht, const char* key)
 {
-    int index = ht_get_hash(key, ht->capacity, 0);
-    ht_item* item = ht->items[index];
-    int i = 1;
+    ht_delete_key(ht, ht_key_cstr(key));
+}
+
+static void ht_prefetch(hash_table* ht, uint64_t hash)
+{
+    size_t pos = HT_H1(hash) & (ht->capacity - 1);
+    __builtin_prefetch(ht->ctrl + pos);
+    if (ht->slots) __builtin_prefetch(ht_slot_at(ht, pos));
+}
+
+void ht_search_many(hash_table* ht, const char** keys, size_t count, void** values)
+{
+    ht_key batch[HT_BATCH_SIZE];
+
+    for (size_t base = 0; base < count; base += HT_BATCH_SIZE) {
+        size_t n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
 
-    while (item != NULL) {
-        if (item != &HT_DELETED_ITEM && strcmp(item->key, key) == 0) {
-            ht_del_item(item);
-            ht->items[index] = &HT_DELETED_ITEM;
-            ht->count--;
-            break;
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = ht_key_cstr(keys[base + i]);
+            ht_prefetch(ht, batch[i].hash);
+        }
+        for (size_t i = 0; i < n; i++) {
+            values[base + i] = ht_find_key(ht, batch[i]);
         }
-        index = ht_get_hash(key, ht->capacity, i);
-        item = ht->items[index];
-        i++;
     }
+}
+
+void ht_insert_many(hash_table* ht, const char** keys, void** values, int value_size, size_t count)
+{
+    ht_key batch[HT_BATCH_SIZE];
 
-    int load = ht->count * 100 / ht->capacity;
-    if (load < 10 && ht->capacity > HT_INITIAL_BASE_SIZE) {
-        ht_resize_down(ht);
+    for (size_t base = 0; base < count; base += HT_BATCH_SIZE) {
+        size_t n = count - base < HT_BATCH_SIZE ? count - base : HT_BATCH_SIZE;
+
+        // A resize in the middle of a batch only makes some prefetches useless
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = ht_key_cstr(keys[base + i]);
+            ht_prefetch(ht, batch[i].hash);
+        }
+        for (size_t i = 0; i < n; i++) {
+            ht_upsert_key(ht, batch[i], values[base + i], value_size);
+        }
     }
 }
 
-void ht_resize(hash_table* ht, const int base_size)
+void* ht_find_symbol(hash_table* ht, const symbol* key)
 {
-    if (base_size < HT_INITIAL_BASE_SIZE) {
-        return;
+    return ht_find_key(ht, ht_key_symbol(key));
+}
+
+void* ht_get_or_insert_symbol(hash_table* ht, const symbol* key, int value_size, bool* inserted)
+{
+    return ht_get_or_insert_key(ht, ht_key_symbol(key), value_size, inserted);
+}
+
+void* ht_upsert_symbol(hash_table* ht, const symbol* key, void* value, int value_size)
+{
+    return ht_upsert_key(ht, ht_key_symbol(key), value, value_size);
+}
+
+void ht_delete_symbol(hash_table* ht, const symbol* key)
+{
+    ht_delete_key(ht, ht_key_symbol(key));
+}
+
+//
+// Small map
+//
+void ht_map_init(ht_map* map, temp_allocator allocator, int value_size)
+{
+    memset(map, 0, sizeof(*map));
+    map->allocator = allocator;
+    map->value_size = value_size;
+}
+
+void ht_map_free(ht_map* map)
+{
+    if (map->table) ht_free(map->table);
+    if (map->values) temp_free(map->values);
+    map->table = NULL;
+    map->values = NULL;
+    map->count = 0;
+}
+
+// Bitmask of the inline keys equal to `key`
+static inline uint32_t ht_map_match(ht_map* map, const symbol* key)
+{
+#ifdef __SSE2__
+    // SSE2 only compares 32-bit lanes: a pointer matches when both halves do
+    __m128i needle = _mm_set1_epi64x((long long)(uintptr_t)key);
+    uint32_t mask = 0;
+    for (int i = 0; i < HT_SMALL_MAP_SIZE; i += 2) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&map->keys[i]), needle);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
     }
-    hash_table* new_ht = ht_init_with_capacity(base_size);
-    for (int i = 0; i < ht->capacity; i++) {
-        ht_item* item = ht->items[i];
-        if (item != NULL && item != &HT_DELETED_ITEM) {
-            ht_insert(new_ht, item->key, item->value, item->value_size);
-        }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HT_SMALL_MAP_SIZE; i++) {
+        if (map->keys[i] == key) mask |= 1u << i;
     }
+    return mask;
+#endif
+}
 
-    ht->base_capacity = new_ht->base_capacity;
-    ht->count = new_ht->count;
-
-    // To delete new_ht, we give it ht's size and items 
-    const int tmp_size = ht->capacity;
-    ht->capacity = new_ht->capacity;
-    new_ht->capacity = tmp_size;
+void* ht_map_find(ht_map* map, const symbol* key)
+{
+    if (map->table) return ht_find_symbol(map->table, key);
 
-    ht_item** tmp_items = ht->items;
-    ht->items = new_ht->items;
-    new_ht->items = tmp_items;
+    // Unused keys are NULL and never match
+    uint32_t match = ht_map_match(map, key);
+    if (match == 0) return NULL;
+    return map->values + __builtin_ctz(match) * map->value_size;
+}
 
-    ht_free(new_ht);
+static void ht_map_upgrade(ht_map* map)
+{
+    // The table shares the map's allocator instead of mapping a chunk of its own
+    map->table = ht_init_symbols_with_allocator(map->allocator, HT_SMALL_MAP_SIZE * 2);
+    for (uint32_t i = 0; i < map->count; i++) {
+        ht_upsert_symbol(map->table, map->keys[i], map->values + i * map->value_size, map->value_size);
+    }
+    temp_free(map->values);
+    map->values = NULL;
 }
 
-void ht_resize_up(hash_table* ht)
+void* ht_map_get_or_insert(ht_map* map, const symbol* key, bool* inserted)
 {
-    const int new_size = ht->base_capacity * 2;
-    ht_resize(ht, new_size);
+    if (!map->table) {
+        uint32_t match = ht_map_match(map, key);
+        if (match != 0) {
+            if (inserted) *inserted = false;
+            return map->values + __builtin_ctz(match) * map->value_size;
+        }
+
+        if (map->count == HT_SMALL_MAP_SIZE) {
+            ht_map_upgrade(map);
+        }
+    }
+    if (map->table) return ht_get_or_insert_symbol(map->table, key, map->value_size, inserted);
+
+    // Capacity is the count rounded up to a power of two
+    if ((map->count & (map->count - 1)) == 0) {
+        size_t capacity = map->count == 0 ? 1 : map->count * 2;
+        map->values = temp_realloc(map->allocator, map->values, capacity * map->value_size);
+        if (!map->values) {
+            perror("Failed to allocate memory for map values");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint8_t* value = map->values + map->count * map->value_size;
+    memset(value, 0, map->value_size);
+    map->keys[map->count++] = key;
+    if (inserted) *inserted = true;
+    return value;
 }
 
-void ht_resize_down(hash_table* ht)
+void* ht_map_upsert(ht_map* map, const symbol* key, void* value)
 {
-    const int new_size = ht->base_capacity / 2;
-    ht_resize(ht, new_size);
+    void* slot_value = ht_map_get_or_insert(map, key, NULL);
+    memcpy(slot_value, value, map->value_size);
+    return slot_value;
 }
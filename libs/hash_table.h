@@ -1,38 +1,133 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "temp_alloc.h"
 
+struct symbol;
+
+// Keys shorter than this (with the terminator) are stored in the slot itself
+#define HT_INLINE_KEY_SIZE 16
+// Control bytes are scanned this many at a time
+#define HT_GROUP_WIDTH 16
+
+//
+// Slots are laid out back to back, each one is an ht_slot header followed by
+// the value bytes. Every slot has the room of the biggest value inserted so
+// far (hash_table.value_stride).
+//
 typedef struct {
-    char* key;
-    void* value;
-    int value_size;
-} ht_item;
+    uint64_t hash;
+    uint32_t key_len;
+    uint32_t value_size;
+    union {
+        char key_inline[HT_INLINE_KEY_SIZE];
+        char* key;
+        const struct symbol* symbol;    // symbol-keyed tables
+    };
+} ht_slot;
 
+//
+// Open addressing in the style of Swiss tables: one control byte per slot
+// holds 7 bits of the hash (or EMPTY/DELETED), and lookups compare a whole
+// group of control bytes at once before touching any slot.
+//
 typedef struct {
-    size_t capacity;
+    size_t capacity;        // number of slots, a power of two
     size_t count;
-    ht_item** items;
+    size_t growth_left;     // inserts left before a rehash, tombstones included
+
+    uint8_t* ctrl;          // capacity + HT_GROUP_WIDTH bytes, the tail mirrors the first group
+    uint8_t* slots;
+    size_t slot_size;
+    size_t value_stride;
+    bool symbol_keys;
 
-    size_t base_capacity;
+    // While resizing, the previous arrays stay around and every insert or
+    // delete moves a few of their slots over. Lookups check both.
+    uint8_t* old_ctrl;      // NULL when no resize is in progress
+    uint8_t* old_slots;
+    size_t old_capacity;
+    size_t old_slot_size;
+    size_t migrate_pos;     // old slots below this have been moved
 
     temp_allocator allocator;
+    bool owns_allocator;    // ht_free destroys the allocator instead of freeing the arrays
 } hash_table;
 
+//
+// Symbol-keyed map that starts as an inline array of up to HT_SMALL_MAP_SIZE
+// keys, scanned with a few SIMD compares, and only builds a hash_table once it
+// outgrows that. All values have the same size. Meant to be embedded by value:
+// an empty map takes no allocation and small ones only their values.
+//
+#define HT_SMALL_MAP_SIZE 8
+
+typedef struct {
+    const struct symbol* keys[HT_SMALL_MAP_SIZE];
+    uint8_t* values;        // value_size bytes per key, grown by powers of two
+    uint32_t count;
+    uint32_t value_size;
+    hash_table* table;      // set once the map outgrew the inline keys
+    temp_allocator allocator;
+} ht_map;
+
 hash_table* ht_init();
 hash_table* ht_init_with_capacity(const int base_capacity);
+// Keyed by interned symbols: keys compare by pointer, reuse the symbol's
+// hash and are never copied. Use the *_symbol functions on these tables.
+hash_table* ht_init_symbols(const int base_capacity);
+// A symbol table living in the caller's allocator, for tables embedded in
+// something that already has one. ht_free releases only the table's blocks.
+hash_table* ht_init_symbols_with_allocator(temp_allocator allocator, const int base_capacity);
 void ht_free(hash_table* ht);
 
+// Value pointers returned by the table stay valid until the next insert or
+// delete. Inserting a key that is already present overwrites its value.
+// Growing and shrinking are incremental, no single call rehashes the table.
 void  ht_insert(hash_table* ht, const char* key, void* value, int value_size);
 void* ht_search(hash_table* ht, const char* key);
 void  ht_delete(hash_table* ht, const char* key);
 bool  ht_has(hash_table* ht, const char* key);
 
+// Single probe primitives, each walks the probe sequence of `key` once:
+//   ht_find_slot     - value slot of `key`, NULL when it is missing
+//   ht_get_or_insert - value slot of `key`, a zeroed one of `value_size`
+//                      bytes is added when it is missing (*inserted is set)
+//   ht_upsert        - store `value` under `key` and return its slot
+void* ht_find_slot(hash_table* ht, const char* key);
+void* ht_get_or_insert(hash_table* ht, const char* key, int value_size, bool* inserted);
+void* ht_upsert(hash_table* ht, const char* key, void* value, int value_size);
+
+// Batched lookups and inserts: the keys are hashed up front and their first
+// probe group prefetched, so the cache misses of a batch overlap instead of
+// being paid one key at a time. values[i] receives the value slot of keys[i]
+// (NULL when missing) for ht_search_many, and is the value to store for
+// ht_insert_many.
+void ht_search_many(hash_table* ht, const char** keys, size_t count, void** values);
+void ht_insert_many(hash_table* ht, const char** keys, void** values, int value_size, size_t count);
+
+void* ht_find_symbol(hash_table* ht, const struct symbol* key);
+void* ht_get_or_insert_symbol(hash_table* ht, const struct symbol* key, int value_size, bool* inserted);
+void* ht_upsert_symbol(hash_table* ht, const struct symbol* key, void* value, int value_size);
+void  ht_delete_symbol(hash_table* ht, const struct symbol* key);
+
+void  ht_map_init(ht_map* map, temp_allocator allocator, int value_size);
+void  ht_map_free(ht_map* map);
+void* ht_map_find(ht_map* map, const struct symbol* key);
+void* ht_map_get_or_insert(ht_map* map, const struct symbol* key, bool* inserted);
+void* ht_map_upsert(ht_map* map, const struct symbol* key, void* value);
+
+uint64_t ht_hash(const char* s, size_t len);
 void ht_to_char(char* cstr, void* data, int data_size);
 
 #define ht_insert_generic_value(ht, key, value_type, value) do { value_type _v = value; ht_insert(ht, key, &_v, sizeof(value_type)); } while(0)
 #define ht_search_generic_value(ht, key, value_type) (value_type*)ht_search(ht, key)
+#define ht_upsert_generic_value(ht, key, value_type, value) ({ value_type _v = value; (value_type*)ht_upsert(ht, key, &_v, sizeof(value_type)); })
 
+// These go through ht_to_char, which overwrites the last key byte. For
+// integer, pointer or struct keys use HT_DECLARE_* from hash_table_typed.h.
 #define ht_insert_generic_key(ht, key_type, key, value_type, value) do { \
     value_type _v = value; \
     key_type _vk = key; \
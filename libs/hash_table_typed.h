@@ -0,0 +1,278 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef HT_MALLOC
+	#define HT_MALLOC malloc
+#endif
+#ifndef HT_FREE
+	#define HT_FREE free
+#endif
+
+//
+// Control bytes, shared by hash_table and the typed tables below: a full
+// slot stores the low 7 bits of its hash (top bit clear), so EMPTY and
+// DELETED are told apart from it by the top bit alone. The ctrl array has
+// HT_GROUP_WIDTH extra bytes mirroring the first group, so a group can be
+// loaded at any slot without wrapping.
+//
+#define HT_CTRL_EMPTY   ((uint8_t)0x80)
+#define HT_CTRL_DELETED ((uint8_t)0xFE)
+
+#define HT_H1(hash) ((hash) >> 7)
+#define HT_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+#define ht_max_load(capacity) ((capacity) - (capacity) / 8)    // 7/8
+
+//
+// Group scans: each returns a bitmask with bit i set when control byte i of
+// the group matches
+//
+#ifdef __SSE2__
+static inline uint32_t ht_group_match(const uint8_t* ctrl, uint8_t h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint32_t ht_group_match_empty(const uint8_t* ctrl)
+{
+    return ht_group_match(ctrl, HT_CTRL_EMPTY);
+}
+
+static inline uint32_t ht_group_match_free(const uint8_t* ctrl)
+{
+    // EMPTY or DELETED, the only bytes with the top bit set
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+}
+#else
+static inline uint32_t ht_group_match(const uint8_t* ctrl, uint8_t h2)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+        if (ctrl[i] == h2) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static inline uint32_t ht_group_match_empty(const uint8_t* ctrl)
+{
+    return ht_group_match(ctrl, HT_CTRL_EMPTY);
+}
+
+static inline uint32_t ht_group_match_free(const uint8_t* ctrl)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+        if (ctrl[i] & 0x80) mask |= 1u << i;
+    }
+    return mask;
+}
+#endif
+
+static inline void ht_ctrl_set(uint8_t* ctrl, size_t capacity, size_t index, uint8_t c)
+{
+    ctrl[index] = c;
+    if (index < HT_GROUP_WIDTH) {
+        ctrl[capacity + index] = c;
+    }
+}
+
+//
+// Probing walks groups in triangular steps (1, 2, 3... groups ahead), which
+// visits every group once when the capacity is a power of two
+//
+static inline size_t ht_ctrl_find_free(const uint8_t* ctrl, size_t capacity, uint64_t hash)
+{
+    size_t mask = capacity - 1;
+    size_t pos = HT_H1(hash) & mask;
+
+    for (size_t step = HT_GROUP_WIDTH;; step += HT_GROUP_WIDTH) {
+        uint32_t match = ht_group_match_free(ctrl + pos);
+        if (match != 0) {
+            return (pos + __builtin_ctz(match)) & mask;
+        }
+        pos = (pos + step) & mask;
+    }
+}
+
+// Free a full slot. Probes stop at the first group with an EMPTY byte: if
+// every group-wide window over the slot has one, no probe ever ran past it
+// and it can go straight back to EMPTY instead of leaving a tombstone.
+// Returns true when it did.
+static inline bool ht_ctrl_erase(uint8_t* ctrl, size_t capacity, size_t index)
+{
+    size_t before = (index - HT_GROUP_WIDTH) & (capacity - 1);
+    uint32_t empty_after = ht_group_match_empty(ctrl + index);
+    uint32_t empty_before = ht_group_match_empty(ctrl + before) << (32 - HT_GROUP_WIDTH);
+    bool was_never_full = empty_after != 0 && empty_before != 0 &&
+                          (size_t)(__builtin_ctz(empty_after) + __builtin_clz(empty_before)) < HT_GROUP_WIDTH;
+
+    ht_ctrl_set(ctrl, capacity, index, was_never_full ? HT_CTRL_EMPTY : HT_CTRL_DELETED);
+    return was_never_full;
+}
+
+//
+// Hashes and equality for the typed tables. Blob keys are hashed and
+// compared byte for byte, so zero the padding of struct keys.
+//
+static inline uint64_t ht_hash_u64(uint64_t x)
+{
+    // murmur3 finalizer
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+#define ht_hash_ptr(p)      ht_hash_u64((uint64_t)(uintptr_t)(p))
+#define ht_hash_blob(k)     ht_hash((const char*)&(k), sizeof(k))
+
+#define ht_eq_scalar(a, b)  ((a) == (b))
+#define ht_eq_blob(a, b)    (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+//
+// Typed tables: HT_DECLARE(name, key_type, value_type, hash_fn, eq_fn)
+// declares `name`, a table storing (key, value) pairs inline, with
+//
+//   void        name_init(name* t);
+//   void        name_free(name* t);
+//   value_type* name_find(name* t, key_type key);
+//   value_type* name_get_or_insert(name* t, key_type key, bool* inserted);
+//   value_type* name_upsert(name* t, key_type key, value_type value);
+//   bool        name_delete(name* t, key_type key);
+//
+// Value pointers stay valid until the next insert or delete. Memory comes
+// from HT_MALLOC/HT_FREE, define them before including this file.
+//
+#define HT_DECLARE_U64(name, value_type)            HT_DECLARE(name, uint64_t, value_type, ht_hash_u64, ht_eq_scalar)
+#define HT_DECLARE_PTR(name, value_type)            HT_DECLARE(name, const void*, value_type, ht_hash_ptr, ht_eq_scalar)
+#define HT_DECLARE_BLOB(name, key_type, value_type) HT_DECLARE(name, key_type, value_type, ht_hash_blob, ht_eq_blob)
+
+#define HT_DECLARE(name, key_type, value_type, hash_fn, eq_fn)                                          \
+    typedef struct {                                                                                    \
+        key_type key;                                                                                   \
+        value_type value;                                                                               \
+    } name##_entry;                                                                                     \
+                                                                                                        \
+    typedef struct {                                                                                    \
+        size_t capacity;                                                                                \
+        size_t count;                                                                                   \
+        size_t growth_left;                                                                             \
+        uint8_t* ctrl;                                                                                  \
+        name##_entry* entries;                                                                          \
+    } name;                                                                                             \
+                                                                                                        \
+    static inline void name##_init(name* t)                                                             \
+    {                                                                                                   \
+        memset(t, 0, sizeof(*t));                                                                       \
+    }                                                                                                   \
+                                                                                                        \
+    static inline void name##_free(name* t)                                                             \
+    {                                                                                                   \
+        if (t->ctrl != NULL) {                                                                          \
+            HT_FREE(t->ctrl);                                                                           \
+            HT_FREE(t->entries);                                                                        \
+        }                                                                                               \
+        memset(t, 0, sizeof(*t));                                                                       \
+    }                                                                                                   \
+                                                                                                        \
+    static inline size_t name##_find_index(const name* t, key_type key, uint64_t hash)                  \
+    {                                                                                                   \
+        if (t->capacity == 0) return 0;                                                                 \
+        size_t mask = t->capacity - 1;                                                                  \
+        size_t pos = HT_H1(hash) & mask;                                                                \
+        for (size_t step = HT_GROUP_WIDTH;; step += HT_GROUP_WIDTH) {                                   \
+            const uint8_t* group = t->ctrl + pos;                                                       \
+            uint32_t match = ht_group_match(group, HT_H2(hash));                                        \
+            while (match != 0) {                                                                        \
+                size_t index = (pos + __builtin_ctz(match)) & mask;                                     \
+                if (eq_fn(t->entries[index].key, key)) return index;                                    \
+                match &= match - 1;                                                                     \
+            }                                                                                           \
+            if (ht_group_match_empty(group) != 0) return t->capacity;                                   \
+            pos = (pos + step) & mask;                                                                  \
+        }                                                                                               \
+    }                                                                                                   \
+                                                                                                        \
+    static inline void name##_rehash(name* t, size_t capacity)                                          \
+    {                                                                                                   \
+        name old = *t;                                                                                  \
+        t->capacity = capacity;                                                                         \
+        t->growth_left = ht_max_load(capacity) - old.count;                                             \
+        t->ctrl = HT_MALLOC(capacity + HT_GROUP_WIDTH);                                                 \
+        t->entries = HT_MALLOC(capacity * sizeof(name##_entry));                                        \
+        assert(t->ctrl != NULL && t->entries != NULL && "Failed to allocate memory");                   \
+        memset(t->ctrl, HT_CTRL_EMPTY, capacity + HT_GROUP_WIDTH);                                      \
+                                                                                                        \
+        for (size_t i = 0; i < old.capacity; i++) {                                                     \
+            if (old.ctrl[i] & 0x80) continue;                                                           \
+            uint64_t hash = hash_fn(old.entries[i].key);                                                \
+            size_t index = ht_ctrl_find_free(t->ctrl, capacity, hash);                                  \
+            ht_ctrl_set(t->ctrl, capacity, index, HT_H2(hash));                                         \
+            t->entries[index] = old.entries[i];                                                         \
+        }                                                                                               \
+        if (old.ctrl != NULL) {                                                                         \
+            HT_FREE(old.ctrl);                                                                          \
+            HT_FREE(old.entries);                                                                       \
+        }                                                                                               \
+    }                                                                                                   \
+                                                                                                        \
+    static inline value_type* name##_find(name* t, key_type key)                                        \
+    {                                                                                                   \
+        size_t index = name##_find_index(t, key, hash_fn(key));                                         \
+        return index == t->capacity ? NULL : &t->entries[index].value;                                  \
+    }                                                                                                   \
+                                                                                                        \
+    static inline value_type* name##_get_or_insert(name* t, key_type key, bool* inserted)               \
+    {                                                                                                   \
+        uint64_t hash = hash_fn(key);                                                                   \
+        size_t index = name##_find_index(t, key, hash);                                                 \
+        if (index != t->capacity) {                                                                     \
+            if (inserted) *inserted = false;                                                            \
+            return &t->entries[index].value;                                                            \
+        }                                                                                               \
+                                                                                                        \
+        if (t->growth_left == 0) {                                                                      \
+            size_t capacity = t->capacity == 0 ? HT_GROUP_WIDTH                                         \
+                            : t->count * 2 < ht_max_load(t->capacity) ? t->capacity : t->capacity * 2;  \
+            name##_rehash(t, capacity);                                                                 \
+        }                                                                                               \
+                                                                                                        \
+        index = ht_ctrl_find_free(t->ctrl, t->capacity, hash);                                          \
+        if (t->ctrl[index] == HT_CTRL_EMPTY) t->growth_left--;                                          \
+        ht_ctrl_set(t->ctrl, t->capacity, index, HT_H2(hash));                                          \
+        t->count++;                                                                                     \
+                                                                                                        \
+        t->entries[index].key = key;                                                                    \
+        memset(&t->entries[index].value, 0, sizeof(value_type));                                        \
+        if (inserted) *inserted = true;                                                                 \
+        return &t->entries[index].value;                                                                \
+    }                                                                                                   \
+                                                                                                        \
+    static inline value_type* name##_upsert(name* t, key_type key, value_type value)                    \
+    {                                                                                                   \
+        value_type* slot = name##_get_or_insert(t, key, NULL);                                          \
+        *slot = value;                                                                                  \
+        return slot;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    static inline bool name##_delete(name* t, key_type key)                                             \
+    {                                                                                                   \
+        size_t index = name##_find_index(t, key, hash_fn(key));                                         \
+        if (index == t->capacity) return false;                                                         \
+        if (ht_ctrl_erase(t->ctrl, t->capacity, index)) t->growth_left++;                               \
+        t->count--;                                                                                     \
+        return true;                                                                                    \
+    }
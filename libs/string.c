@@ -1,6 +1,315 @@
 #include "string.h"
 #include <stdarg.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if !defined(SV_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+    #define SV_SIMD
+    #include <immintrin.h>
+#endif
+
+// KERNELS
+// Every kernel has a scalar version that is always available and is the
+// reference the SIMD versions are checked against. The best supported set is
+// picked once at startup; sv_kernel_set switches at runtime.
+
+// isspace() in the C locale: ' ' and '\t' .. '\r'
+static inline bool sv_is_space(unsigned char c)
+{
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static size_t find_c_scalar(const char* data, size_t count, char c)
+{
+    const char* found = memchr(data, c, count);
+    return found ? (size_t)(found - data) : count;
+}
+
+static size_t find_sv_scalar(const char* data, size_t count, const char* needle, size_t needle_count)
+{
+    if (needle_count == 0) return 0;
+    if (needle_count > count) return count;
+    for (size_t i = 0; i + needle_count <= count; i++) {
+        if (data[i] == needle[0] && memcmp(data + i, needle, needle_count) == 0) return i;
+    }
+    return count;
+}
+
+static bool equal_scalar(const char* a, const char* b, size_t count)
+{
+    return memcmp(a, b, count) == 0;
+}
+
+static size_t skip_space_scalar(const char* data, size_t count)
+{
+    size_t i = 0;
+    while (i < count && sv_is_space(data[i])) i += 1;
+    return i;
+}
+
+static size_t skip_space_back_scalar(const char* data, size_t count)
+{
+    size_t i = 0;
+    while (i < count && sv_is_space(data[count - 1 - i])) i += 1;
+    return i;
+}
+
+#ifdef SV_SIMD
+
+static inline __m128i space_mask_sse2(__m128i block)
+{
+    __m128i blank = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+    __m128i ctrl  = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('\t' - 1)),
+                                  _mm_cmplt_epi8(block, _mm_set1_epi8('\r' + 1)));
+    return _mm_or_si128(blank, ctrl);
+}
+
+static size_t find_c_sse2(const char* data, size_t count, char c)
+{
+    __m128i target = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < count; i++) {
+        if (data[i] == c) return i;
+    }
+    return count;
+}
+
+// Compares the first and last byte of the needle at 16 positions at once and
+// only runs memcmp where both match.
+static size_t find_sv_sse2(const char* data, size_t count, const char* needle, size_t needle_count)
+{
+    if (needle_count == 0) return 0;
+    if (needle_count > count) return count;
+    if (needle_count == 1) return find_c_sse2(data, count, needle[0]);
+
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last  = _mm_set1_epi8(needle[needle_count - 1]);
+    size_t end = count - needle_count + 1;  // candidate starts are [0, end)
+    size_t i = 0;
+    for (; i + 16 <= end; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i block_last  = _mm_loadu_si128((const __m128i*)(data + i + needle_count - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                        _mm_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(data + at + 1, needle + 1, needle_count - 2) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = find_sv_scalar(data + i, count - i, needle, needle_count);
+    return rest == count - i ? count : i + rest;
+}
+
+static bool equal_sse2(const char* a, const char* b, size_t count)
+{
+    if (count < 16) return memcmp(a, b, count) == 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return false;
+    }
+    if (i == count) return true;
+    // Overlapping load for the tail
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + count - 16));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + count - 16));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+}
+
+static size_t skip_space_sse2(const char* data, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = ~_mm_movemask_epi8(space_mask_sse2(block)) & 0xFFFF;
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + skip_space_scalar(data + i, count - i);
+}
+
+static size_t skip_space_back_sse2(const char* data, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + count - i - 16));
+        unsigned mask = ~_mm_movemask_epi8(space_mask_sse2(block)) & 0xFFFF;
+        if (mask) return i + __builtin_clz(mask) - 16;
+    }
+    return i + skip_space_back_scalar(data, count - i);
+}
+
+#define SV_AVX2 __attribute__((target("avx2")))
+
+SV_AVX2 static inline __m256i space_mask_avx2(__m256i block)
+{
+    __m256i blank = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '));
+    __m256i ctrl  = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('\t' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), block));
+    return _mm256_or_si256(blank, ctrl);
+}
+
+// The AVX2 kernels hand short inputs and tails to the SSE2 ones, clearing the
+// upper halves first so the legacy SSE code does not pay a transition stall.
+SV_AVX2 static size_t find_c_avx2(const char* data, size_t count, char c)
+{
+    if (count < 32) return find_c_sse2(data, count, c);
+
+    __m256i target = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    _mm256_zeroupper();
+    return i + find_c_sse2(data + i, count - i, c);
+}
+
+SV_AVX2 static size_t find_sv_avx2(const char* data, size_t count, const char* needle, size_t needle_count)
+{
+    if (needle_count == 0) return 0;
+    if (needle_count > count) return count;
+    if (needle_count == 1) return find_c_avx2(data, count, needle[0]);
+    if (count - needle_count + 1 < 32) return find_sv_sse2(data, count, needle, needle_count);
+
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last  = _mm256_set1_epi8(needle[needle_count - 1]);
+    size_t end = count - needle_count + 1;
+    size_t i = 0;
+    for (; i + 32 <= end; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i block_last  = _mm256_loadu_si256((const __m256i*)(data + i + needle_count - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                                                              _mm256_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(data + at + 1, needle + 1, needle_count - 2) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+    _mm256_zeroupper();
+    size_t rest = find_sv_sse2(data + i, count - i, needle, needle_count);
+    return rest == count - i ? count : i + rest;
+}
+
+SV_AVX2 static bool equal_avx2(const char* a, const char* b, size_t count)
+{
+    if (count < 32) return equal_sse2(a, b, count);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) return false;
+    }
+    if (i == count) return true;
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + count - 32));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + count - 32));
+    return (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) == 0xFFFFFFFFu;
+}
+
+SV_AVX2 static size_t skip_space_avx2(const char* data, size_t count)
+{
+    if (count < 32) return skip_space_sse2(data, count);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(space_mask_avx2(block));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    _mm256_zeroupper();
+    return i + skip_space_sse2(data + i, count - i);
+}
+
+SV_AVX2 static size_t skip_space_back_avx2(const char* data, size_t count)
+{
+    if (count < 32) return skip_space_back_sse2(data, count);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + count - i - 32));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(space_mask_avx2(block));
+        if (mask) return i + __builtin_clz(mask);
+    }
+    _mm256_zeroupper();
+    return i + skip_space_back_sse2(data, count - i);
+}
+
+#endif // SV_SIMD
+
+typedef struct {
+    size_t (*find_c)(const char* data, size_t count, char c);
+    size_t (*find_sv)(const char* data, size_t count, const char* needle, size_t needle_count);
+    bool   (*equal)(const char* a, const char* b, size_t count);
+    size_t (*skip_space)(const char* data, size_t count);
+    size_t (*skip_space_back)(const char* data, size_t count);
+} sv_kernels;
+
+static const sv_kernels kernels_scalar = {
+    find_c_scalar, find_sv_scalar, equal_scalar, skip_space_scalar, skip_space_back_scalar,
+};
+
+#ifdef SV_SIMD
+static const sv_kernels kernels_sse2 = {
+    find_c_sse2, find_sv_sse2, equal_sse2, skip_space_sse2, skip_space_back_sse2,
+};
+
+static const sv_kernels kernels_avx2 = {
+    find_c_avx2, find_sv_avx2, equal_avx2, skip_space_avx2, skip_space_back_avx2,
+};
+#endif
+
+static sv_kernels kernels = {
+    find_c_scalar, find_sv_scalar, equal_scalar, skip_space_scalar, skip_space_back_scalar,
+};
+static sv_kernel_level kernel_level = SV_KERNEL_SCALAR;
+
+static sv_kernel_level sv_kernel_supported()
+{
+#ifdef SV_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SV_KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SV_KERNEL_SSE2;
+#endif
+    return SV_KERNEL_SCALAR;
+}
+
+sv_kernel_level sv_kernel_set(sv_kernel_level level)
+{
+    sv_kernel_level supported = sv_kernel_supported();
+    if (level > supported) level = supported;
+
+    switch (level) {
+#ifdef SV_SIMD
+    case SV_KERNEL_AVX2: kernels = kernels_avx2; break;
+    case SV_KERNEL_SSE2: kernels = kernels_sse2; break;
+#endif
+    default:             kernels = kernels_scalar; level = SV_KERNEL_SCALAR; break;
+    }
+
+    kernel_level = level;
+    return level;
+}
+
+sv_kernel_level sv_kernel_get()
+{
+    return kernel_level;
+}
+
+__attribute__((constructor))
+static void sv_kernel_init()
+{
+    sv_kernel_set(SV_KERNEL_AVX2);
+}
 
 string_view sv_from_parts(const char* data, size_t count)
 {
@@ -29,10 +338,7 @@ string_view sv_split_cstr(string_view *sv, char* spliter)
 
 string_view sv_split_c(string_view *sv, char spliter)
 {
-    size_t i = 0;
-    while (i < sv->count && sv->data[i] != spliter) {
-        i += 1;
-    }
+    size_t i = kernels.find_c(sv->data, sv->count, spliter);
 
     string_view result = sv_from_parts(sv->data, i);
 
@@ -71,7 +377,7 @@ bool sv_equal(string_view a, string_view b)
     if (a.count != b.count) {
         return false;
     } else {
-        return memcmp(a.data, b.data, a.count) == 0;
+        return kernels.equal(a.data, b.data, a.count);
     }
 }
 
@@ -81,28 +387,37 @@ bool sv_equal_c(string_view a, const char b)
 	return a.data[0] == b;
 }
 
+// strnlen stops one byte past sv.count, so a long cstr is never scanned
+// to its end
 bool sv_equal_cstr(string_view a, const char* b)
 {
-	return sv_equal(a, sv_from_cstr(b));
+	if (strnlen(b, a.count + 1) != a.count) return false;
+	return kernels.equal(a.data, b, a.count);
 }
 
 bool sv_start_with(string_view sv, const char* cstr)
 {
-	size_t cstr_count = strlen(cstr);
+	size_t cstr_count = strnlen(cstr, sv.count + 1);
 	if (sv.count < cstr_count) return false;
 
-	return memcmp(sv.data, cstr, cstr_count) == 0;
+	return kernels.equal(sv.data, cstr, cstr_count);
+}
+
+bool sv_start_with_sv(string_view sv, string_view prefix)
+{
+	if (sv.count < prefix.count) return false;
+	return kernels.equal(sv.data, prefix.data, prefix.count);
 }
 
 bool sv_end_with(string_view sv, const char *cstr)
 {
-    size_t cstr_count = strlen(cstr);
-    if (sv.count >= cstr_count) {
-        size_t ending_start = sv.count - cstr_count;
-        string_view sv_ending = sv_from_parts(sv.data + ending_start, cstr_count);
-        return sv_equal_cstr(sv_ending, cstr);
-    }
-    return false;
+	return sv_end_with_sv(sv, sv_from_cstr(cstr));
+}
+
+bool sv_end_with_sv(string_view sv, string_view suffix)
+{
+	if (sv.count < suffix.count) return false;
+	return kernels.equal(sv.data + sv.count - suffix.count, suffix.data, suffix.count);
 }
 
 bool sv_isdigit(const char c)
@@ -110,25 +425,54 @@ bool sv_isdigit(const char c)
 	return c >= '0' && c <= '9';
 }
 
+// True when all 8 bytes of the little-endian word are '0'..'9'
+static inline bool swar_all_digits(uint64_t word)
+{
+	return ((word & 0xF0F0F0F0F0F0F0F0ull) |
+	        (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// Eight ASCII digits to their value with three multiplies, pairing up
+// digits, then pairs, then quads
+static inline uint64_t swar_parse_8(uint64_t word)
+{
+	word = (word & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+	word = (word & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+	return (word & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+}
+
+size_t sv_to_digit_scalar(string_view sv)
+{
+	size_t value = 0;
+	for (size_t i = 0; i < sv.count && sv_isdigit(sv.data[i]); i++) {
+		value = value * 10 + (sv.data[i] - '0');
+	}
+	return value;
+}
+
+// Parses the leading digits, stopping at the first other character
 size_t sv_to_digit(string_view sv)
 {
 	size_t value = 0;
-	int n;
-	for (int i = 0; i < sv.count; i++) {
-		if (isdigit(sv.data[i]) == 0) break;
-		n = sv.data[i] - '0';
-		if (n > 9) return value;
-		if (i == 0) {
-			value = value + n;
-		} else {
-			value = value * 10 + n;
-		}
+	size_t i = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	for (; i + 8 <= sv.count; i += 8) {
+		uint64_t word;
+		memcpy(&word, sv.data + i, sizeof(word));
+		if (!swar_all_digits(word)) break;
+		value = value * 100000000 + swar_parse_8(word);
+	}
+#endif
+
+	for (; i < sv.count && sv_isdigit(sv.data[i]); i++) {
+		value = value * 10 + (sv.data[i] - '0');
 	}
 	return value;
 }
 
 string_view sv_from_digit(size_t n) {
-    static char buffer[21];
+    static _Thread_local char buffer[21];
     size_t i = 20;
     buffer[i] = '\0';
 
@@ -143,21 +487,15 @@ string_view sv_from_digit(size_t n) {
 
 string_view sv_trim_left(string_view sv)
 {
-    size_t i = 0;
-    while (i < sv.count && isspace(sv.data[i])) {
-        i += 1;
-    }
-
+    if (sv.count == 0 || !sv_is_space(sv.data[0])) return sv;
+    size_t i = kernels.skip_space(sv.data, sv.count);
     return sv_from_parts(sv.data + i, sv.count - i);
 }
 
 string_view sv_trim_right(string_view sv)
 {
-    size_t i = 0;
-    while (i < sv.count && isspace(sv.data[sv.count - 1 - i])) {
-        i += 1;
-    }
-
+    if (sv.count == 0 || !sv_is_space(sv.data[sv.count - 1])) return sv;
+    size_t i = kernels.skip_space_back(sv.data, sv.count);
     return sv_from_parts(sv.data, sv.count - i);
 }
 
@@ -169,7 +507,7 @@ string_view sv_trim(string_view sv)
 bool sv_in(string_view sv, const char** arr, int count)
 {
     for (int i = 0; i < count; i++) {
-        if (sv_equal(sv_from_cstr(arr[i]), sv)) {
+        if (sv_equal_cstr(sv, arr[i])) {
             return true;
         }
     }
@@ -179,10 +517,17 @@ bool sv_in(string_view sv, const char** arr, int count)
 bool sv_in_sv(string_view a, string_view b)
 {
 	if (a.count < b.count) return false;
-	for (int i = 0; i < a.count; i++) {
-		if (sv_equal(sv_from_parts(a.data + i, b.count), b)) return true;
-	}
-	return false;
+	return kernels.find_sv(a.data, a.count, b.data, b.count) < a.count;
+}
+
+size_t sv_find_c(string_view sv, const char c)
+{
+	return kernels.find_c(sv.data, sv.count, c);
+}
+
+size_t sv_find_sv(string_view sv, string_view needle)
+{
+	return kernels.find_sv(sv.data, sv.count, needle.data, needle.count);
 }
 
 bool sv_in_cstr(string_view a, const char* cstr)
@@ -192,10 +537,7 @@ bool sv_in_cstr(string_view a, const char* cstr)
 
 bool sv_in_c(string_view a, const char c)
 {
-	for (int i = 0; i < a.count; i++) {
-		if (a.data[i] == c) return true;
-	}
-	return false;
+	return kernels.find_c(a.data, a.count, c) < a.count;
 }
 
 string_view sb_to_sv(string_builder* sb)
@@ -258,23 +600,206 @@ void sb_delete_c(string_builder* sb, int index)
     da_delete(sb, index);
 }
 
+void sb_reserve(string_builder* sb, size_t n)
+{
+    if (sb->count + n <= sb->capacity) return;
+
+    size_t capacity = sb->capacity < 16 ? 16 : sb->capacity * 2;
+    while (capacity < sb->count + n) {
+        capacity *= 2;
+    }
+
+    sb->items = DA_REALLOC(sb->items, capacity);
+    DA_ASSERT(sb->items != NULL && "Failed to allocate memory");
+    sb->capacity = capacity;
+}
+
+// Formats straight into the free tail. Only when the output does not fit is
+// the tail grown and the format run a second time.
+void sb_add_vf(string_builder* sb, const char *format, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+
+    sb_reserve(sb, 1);
+    size_t available = sb->capacity - sb->count;
+    int n = vsnprintf(sb->items + sb->count, available, format, args);
+    DA_ASSERT(n >= 0);
+
+    if ((size_t)n >= available) {
+        sb_reserve(sb, n + 1);
+        vsnprintf(sb->items + sb->count, n + 1, format, retry);
+    }
+    va_end(retry);
+
+    sb->count += n;
+}
+
 void sb_add_f(string_builder* sb, const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    int n = vsnprintf(NULL, 0, format, args);
+    sb_add_vf(sb, format, args);
     va_end(args);
+}
 
-    DA_ASSERT(n >= 0);
-    char* temp = (char*)malloc(n + 1);
-    DA_ASSERT(temp != NULL && "Failed to allocate memory\n");
+// CHUNKED BUILDER
+static string_chunk* sc_tail_with(string_chunks* sc, size_t n)
+{
+    if (sc->count > 0) {
+        string_chunk* tail = &sc->items[sc->count - 1];
+        if (tail->capacity - tail->count >= n) return tail;
+    }
+
+    string_chunk chunk = {0};
+    chunk.capacity = n > SC_CHUNK_SIZE ? n : SC_CHUNK_SIZE;
+    chunk.data = DA_MALLOC(chunk.capacity);
+    DA_ASSERT(chunk.data != NULL && "Failed to allocate memory");
+
+    if (sc->capacity == 0) da_init_with_capacity(sc, 8);
+    da_append(sc, chunk);
+    return &sc->items[sc->count - 1];
+}
+
+string_chunks sc_init()
+{
+    string_chunks sc = {0};
+    return sc;
+}
+
+void sc_free(string_chunks* sc)
+{
+    for (size_t i = 0; i < sc->count; i++) {
+        DA_FREE(sc->items[i].data);
+    }
+    da_free(sc);
+    sc->items = NULL;
+    sc->size = 0;
+}
+
+void sc_clear(string_chunks* sc)
+{
+    for (size_t i = 1; i < sc->count; i++) {
+        DA_FREE(sc->items[i].data);
+    }
+    if (sc->count > 0) {
+        sc->items[0].count = 0;
+        sc->count = 1;
+    }
+    sc->size = 0;
+}
+
+// Fills the tail chunk and continues in new ones, nothing written is moved
+void sc_add(string_chunks* sc, string_view sv)
+{
+    sc->size += sv.count;
+
+    if (sc->count > 0) {
+        string_chunk* tail = &sc->items[sc->count - 1];
+        if (tail->capacity - tail->count >= sv.count) {
+            memcpy(tail->data + tail->count, sv.data, sv.count);
+            tail->count += sv.count;
+            return;
+        }
+    }
+
+    while (sv.count > 0) {
+        string_chunk* tail = sc_tail_with(sc, 1);
+        size_t n = tail->capacity - tail->count;
+        if (n > sv.count) n = sv.count;
+
+        memcpy(tail->data + tail->count, sv.data, n);
+        tail->count += n;
+        sv.data += n;
+        sv.count -= n;
+    }
+}
+
+void sc_add_cstr(string_chunks* sc, const char* cstr)
+{
+    sc_add(sc, sv_from_cstr(cstr));
+}
 
+void sc_add_c(string_chunks* sc, const char c)
+{
+    string_chunk* tail = sc_tail_with(sc, 1);
+    tail->data[tail->count++] = c;
+    sc->size += 1;
+}
+
+// Output that does not fit the tail chunk gets a chunk of its own
+void sc_add_f(string_chunks* sc, const char* format, ...)
+{
+    va_list args, retry;
     va_start(args, format);
-    vsnprintf(temp, n + 1, format, args);
+    va_copy(retry, args);
+
+    string_chunk* tail = sc_tail_with(sc, 1);
+    size_t available = tail->capacity - tail->count;
+    int n = vsnprintf(tail->data + tail->count, available, format, args);
+    DA_ASSERT(n >= 0);
+
+    if ((size_t)n >= available) {
+        tail = sc_tail_with(sc, n + 1);
+        vsnprintf(tail->data + tail->count, n + 1, format, retry);
+    }
+    va_end(retry);
     va_end(args);
 
-	sb_add_cstr(sb, temp);
-	free(temp);
+    tail->count += n;
+    sc->size += n;
+}
+
+// Writes every chunk with one writev per 64 chunks (4MB), well below the
+// IOV_MAX of 1024 on Linux, and retries short writes
+bool sc_write(string_chunks* sc, int fd)
+{
+    struct iovec iov[64];
+    size_t chunk = 0;
+    size_t offset = 0;
+
+    while (chunk < sc->count) {
+        int iov_count = 0;
+        for (size_t i = chunk; i < sc->count && iov_count < (int)arr_count(iov); i++) {
+            size_t skip = i == chunk ? offset : 0;
+            iov[iov_count].iov_base = sc->items[i].data + skip;
+            iov[iov_count].iov_len  = sc->items[i].count - skip;
+            iov_count += 1;
+        }
+
+        ssize_t written = writev(fd, iov, iov_count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // Advance past what was written, possibly stopping inside a chunk
+        size_t left = written;
+        while (chunk < sc->count && left >= sc->items[chunk].count - offset) {
+            left -= sc->items[chunk].count - offset;
+            chunk += 1;
+            offset = 0;
+        }
+        offset += left;
+    }
+
+    return true;
+}
+
+bool sc_write_fp(string_chunks* sc, FILE* fp)
+{
+    if (fflush(fp) != 0) return false;
+    return sc_write(sc, fileno(fp));
+}
+
+void sc_to_sb(string_chunks* sc, string_builder* sb)
+{
+    sb_reserve(sb, sc->size + 1);
+    for (size_t i = 0; i < sc->count; i++) {
+        memcpy(sb->items + sb->count, sc->items[i].data, sc->items[i].count);
+        sb->count += sc->items[i].count;
+    }
+    sb->items[sb->count] = '\0';
 }
 
 // UTILS
@@ -284,17 +809,22 @@ bool sb_read_file(string_builder* sb, const char* file_path)
     if (file == NULL) return false;
 
     bool result = sb_read_file_from_fp(sb, file);
-    if (!result) fclose(file);
+    fclose(file);
 
     return result;
 }
 
+// Reads straight into the reserved tail and keeps the contents NUL
+// terminated, so items can be used as a C string afterwards
 bool sb_read_file_from_fp(string_builder* sb, FILE* fp)
 {
-    int ch;
-    while ((ch = fgetc(fp)) != EOF) {
-        sb_add_c(sb, ch);
+    for (;;) {
+        sb_reserve(sb, SB_READ_SIZE + 1);
+        size_t n = fread(sb->items + sb->count, 1, sb->capacity - sb->count - 1, fp);
+        sb->count += n;
+        if (n == 0) break;
     }
+    sb->items[sb->count] = '\0';
 
     if (ferror(fp)) {
         return false;
@@ -2,6 +2,7 @@
 
 #include "dynamic_array.h"
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -16,8 +17,40 @@ typedef struct {
     size_t count;
 } string_view;
 
+// A builder for large outputs: text goes into a list of fixed-size chunks,
+// so appending never moves what was already written, and sc_write hands all
+// chunks to one writev.
+#define SC_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+    char* data;
+    size_t count;
+    size_t capacity;
+} string_chunk;
+
+typedef struct {
+    string_chunk* items;
+    size_t capacity;
+    size_t count;
+    size_t size;    // total bytes over all chunks
+} string_chunks;
+
+#define SB_READ_SIZE (64 * 1024)
+
 #define sv_fmt(sv) (int)sv.count, sv.data
 
+// Search, compare and trim run on SSE2 or AVX2 kernels picked at startup from
+// the CPU features. Build with -DSV_NO_SIMD to only use the scalar ones.
+typedef enum {
+    SV_KERNEL_SCALAR,
+    SV_KERNEL_SSE2,
+    SV_KERNEL_AVX2,
+} sv_kernel_level;
+
+// Returns the level actually selected, at most what the CPU supports
+sv_kernel_level sv_kernel_set(sv_kernel_level level);
+sv_kernel_level sv_kernel_get();
+
 string_view sv_from_cstr(const char* cstr);
 string_view sv_from_parts(const char* data, size_t count);
 
@@ -33,10 +66,13 @@ bool sv_equal_c(string_view a, const char b);
 bool sv_equal_cstr(string_view a, const char* b);
 
 bool sv_start_with(string_view sv, const char* cstr);
+bool sv_start_with_sv(string_view sv, string_view prefix);
 bool sv_end_with(string_view sv, const char *cstr);
+bool sv_end_with_sv(string_view sv, string_view suffix);
 
 bool sv_isdigit(const char sv);
 size_t sv_to_digit(string_view sv);
+size_t sv_to_digit_scalar(string_view sv);
 string_view sv_from_digit(size_t n);
 
 string_view sv_trim_left(string_view sv);
@@ -47,6 +83,9 @@ bool sv_in(string_view sv, const char** arr, int count);
 bool sv_in_sv(string_view a, string_view b);
 bool sv_in_cstr(string_view a, const char* cstr);
 bool sv_in_c(string_view a, const char c);
+// Index of the first match, sv.count when there is none
+size_t sv_find_c(string_view sv, const char c);
+size_t sv_find_sv(string_view sv, string_view needle);
 #define sv_in_carr(sv, arr) sv_in(sv, arr, arr_count(arr))
 
 string_builder sb_init(const char* cstr);
@@ -62,10 +101,27 @@ void sb_add_c(string_builder* sb, const char c);
 void sb_add_first_c(string_builder* sb, const char c);
 void sb_delete_c(string_builder* sb, int index);
 
+// Make room for n more bytes without changing count
+void sb_reserve(string_builder* sb, size_t n);
+
 void sb_add_f(string_builder* sb, const char *format, ...);
+void sb_add_vf(string_builder* sb, const char *format, va_list args);
 
 void sb_clear(string_builder* sb);
 
+string_chunks sc_init();
+void sc_free(string_chunks* sc);
+void sc_clear(string_chunks* sc);
+
+void sc_add(string_chunks* sc, string_view sv);
+void sc_add_cstr(string_chunks* sc, const char* cstr);
+void sc_add_c(string_chunks* sc, const char c);
+void sc_add_f(string_chunks* sc, const char* format, ...);
+
+bool sc_write(string_chunks* sc, int fd);
+bool sc_write_fp(string_chunks* sc, FILE* fp);
+void sc_to_sb(string_chunks* sc, string_builder* sb);
+
 // UTILS
 bool sb_read_file(string_builder* sb, const char* file_path);
 bool sb_read_file_from_fp(string_builder* sb, FILE* fp);
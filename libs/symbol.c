@@ -0,0 +1,101 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbol.h"
+#include "hash_table.h"
+#include "temp_alloc.h"
+
+#define SYMBOLS_INITIAL_CAPACITY 256    // power of two
+
+// Linear probing over symbol pointers, names are only compared when the
+// cached hashes are equal
+static struct {
+    const symbol** items;
+    size_t capacity;
+    size_t count;
+    temp_allocator allocator;
+} symbols = {0};
+
+static pthread_mutex_t symbols_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void symbols_grow()
+{
+    size_t capacity = symbols.capacity ? symbols.capacity * 2 : SYMBOLS_INITIAL_CAPACITY;
+    const symbol** items = temp_alloc(symbols.allocator, capacity * sizeof(symbol*));
+    if (!items) {
+        perror("Failed to allocate memory for symbols");
+        exit(EXIT_FAILURE);
+    }
+    memset(items, 0, capacity * sizeof(symbol*));
+
+    for (size_t i = 0; i < symbols.capacity; i++) {
+        const symbol* s = symbols.items[i];
+        if (s == NULL) continue;
+
+        size_t index = s->hash & (capacity - 1);
+        while (items[index] != NULL) {
+            index = (index + 1) & (capacity - 1);
+        }
+        items[index] = s;
+    }
+
+    if (symbols.items) temp_free(symbols.items);
+    symbols.items = items;
+    symbols.capacity = capacity;
+}
+
+const symbol* symbol_intern(string_view name)
+{
+    uint64_t hash = ht_hash(name.data, name.count);
+
+    pthread_mutex_lock(&symbols_lock);
+
+    if (symbols.allocator.arena == NULL) {
+        symbols.allocator = temp_init();
+        temp_set_name(symbols.allocator, "symbols");
+    }
+    if ((symbols.count + 1) * 4 > symbols.capacity * 3) {
+        symbols_grow();
+    }
+
+    size_t index = hash & (symbols.capacity - 1);
+    const symbol* s;
+    while ((s = symbols.items[index]) != NULL) {
+        if (s->hash == hash && s->len == name.count && memcmp(s->name, name.data, name.count) == 0) {
+            pthread_mutex_unlock(&symbols_lock);
+            return s;
+        }
+        index = (index + 1) & (symbols.capacity - 1);
+    }
+
+    symbol* new_symbol = temp_alloc(symbols.allocator, sizeof(symbol) + name.count + 1);
+    if (!new_symbol) {
+        perror("Failed to allocate memory for symbol");
+        exit(EXIT_FAILURE);
+    }
+    new_symbol->hash = hash;
+    new_symbol->len = name.count;
+    memcpy(new_symbol->name, name.data, name.count);
+    new_symbol->name[name.count] = '\0';
+
+    symbols.items[index] = new_symbol;
+    symbols.count++;
+
+    pthread_mutex_unlock(&symbols_lock);
+    return new_symbol;
+}
+
+void symbols_free()
+{
+    pthread_mutex_lock(&symbols_lock);
+    if (symbols.allocator.arena != NULL) {
+        temp_uninit(symbols.allocator);
+    }
+    symbols.items = NULL;
+    symbols.capacity = 0;
+    symbols.count = 0;
+    symbols.allocator = (temp_allocator){0};
+    pthread_mutex_unlock(&symbols_lock);
+}
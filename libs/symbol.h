@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "string.h"
+
+//
+// Interned identifiers: equal names always give the same symbol, so symbols
+// compare by pointer and carry their hash with them. Symbols live until
+// symbols_free and are shared by every thread.
+//
+typedef struct symbol {
+    uint64_t hash;      // ht_hash of the name
+    size_t len;
+    char name[];        // NUL terminated
+} symbol;
+
+const symbol* symbol_intern(string_view name);
+void symbols_free();
+
+#define sym_fmt(s) (int)(s)->len, (s)->name
@@ -1,85 +1,690 @@
+#define _GNU_SOURCE     // mremap
 #include "temp_alloc.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-#define TEMP_CAPACITY   (1024 * 128)   // 1MB
-#define TEMP_INIT_COUNT (100)          // 10MB
+#define TEMP_ALIGNMENT       (16)
+#define TEMP_CHUNK_MIN_SIZE  (1024 * 64)          // 64KB, first chunk of every allocator
+#define TEMP_CHUNK_MAX_SIZE  (1024 * 1024 * 16)   // 16MB, geometric growth stops here
+#define TEMP_LARGE_THRESHOLD (1024 * 32)          // 32KB, bigger blocks get their own mapping
+#define TEMP_KEEP_DIRTY      (1024 * 16)          // 16KB stay resident when a chunk is reset
+#define TEMP_CACHE_MAX       (16)                 // TEMP_CHUNK_MIN_SIZE chunks cached per thread
+#define TEMP_POOL_MAX        (64)                 // TEMP_CHUNK_MIN_SIZE chunks shared by all threads
+#define TEMP_BIN_COUNT       (32)                 // exact-size free lists up to 512 bytes
+#define TEMP_STATS_GROUPS    (32)                 // allocator names in temp_print_stats, the last is "(other)"
+#define TEMP_CALLSITES_MAX   (1024)
+#define TEMP_HUGE_PAGE_SIZE  (1024 * 1024 * 2)    // 2MB, mappings this big may use huge pages
 
-static uint8_t temp_memory[TEMP_INIT_COUNT][TEMP_CAPACITY] = {0};
-static bool temp_used[TEMP_INIT_COUNT] = {0};
+#define TEMP_ALIGN_UP(n) (((n) + TEMP_ALIGNMENT - 1) & ~(size_t)(TEMP_ALIGNMENT - 1))
+
+typedef enum {
+    TEMP_MAP_NORMAL,
+    TEMP_MAP_HUGETLB,   // explicit huge pages from the hugetlb pool
+    TEMP_MAP_THP,       // huge page aligned and advised with MADV_HUGEPAGE
+} temp_map_kind;
+
+typedef struct temp_chunk {
+    struct temp_chunk* prev;
+    temp_map_kind kind;
+    size_t capacity;    // size of the whole mapping
+    size_t base;        // offset of the first block
+    size_t used;        // bump offset
+    size_t dirty;       // high-water mark, pages past it still read as zero
+    size_t position;    // logical offset of `base` inside the allocator
+} temp_chunk;
+
+typedef struct temp_large {
+    struct temp_large* prev;
+    struct temp_large* next;
+    struct temp_arena* arena;
+    temp_map_kind kind;
+    size_t map_size;
+    size_t seq;         // allocation order, used by checkpoints
+} temp_large;
 
 typedef struct {
-    size_t size;
+    uint32_t size;
     bool used;
+    bool large;
+    struct temp_arena* arena;
 } block_header;
 
-temp_allocator temp_init()
+struct temp_arena {
+    temp_chunk* first;
+    temp_chunk* current;
+    temp_large* large;      // newest first
+    size_t large_seq;
+    size_t next_chunk_size;
+    size_t saved_position;  // last checkpoint, blocks below it never grow in place
+    block_header* bins[TEMP_BIN_COUNT];
+
+    // Telemetry
+    const char* name;
+    size_t reserved_bytes;
+    size_t large_bytes;
+    size_t peak_bytes;
+    size_t alloc_count;
+    size_t free_count;
+    size_t size_classes[TEMP_SIZE_CLASS_COUNT];
+    bool registered;
+    struct temp_arena* stats_prev;
+    struct temp_arena* stats_next;
+};
+
+#define TEMP_CHUNK_HEADER TEMP_ALIGN_UP(sizeof(temp_chunk))
+#define TEMP_LARGE_HEADER TEMP_ALIGN_UP(sizeof(temp_large))
+
+//
+// Free min-size chunks are recycled through a per-thread cache first and a
+// shared pool second. The pool is a fixed array of slots claimed with
+// compare-and-swap, so no thread ever touches a chunk it did not take out
+// of a slot and there is no lock or ABA problem.
+//
+typedef struct {
+    temp_chunk* chunks[TEMP_CACHE_MAX];
+    size_t count;
+    bool registered;
+} temp_chunk_cache;
+
+static _Thread_local temp_chunk_cache temp_cache = {0};
+static _Atomic(temp_chunk*) temp_pool[TEMP_POOL_MAX] = {0};
+
+static pthread_key_t temp_cache_key;
+static pthread_once_t temp_cache_key_once = PTHREAD_ONCE_INIT;
+
+static size_t temp_page_size()
+{
+    static _Atomic size_t page_size = 0;
+    size_t size = atomic_load_explicit(&page_size, memory_order_relaxed);
+    if (size == 0) {
+        size = (size_t)sysconf(_SC_PAGESIZE);
+        atomic_store_explicit(&page_size, size, memory_order_relaxed);
+    }
+    return size;
+}
+
+static bool temp_pool_push(temp_chunk* chunk)
+{
+    for (size_t i = 0; i < TEMP_POOL_MAX; i++) {
+        temp_chunk* expected = NULL;
+        if (atomic_load_explicit(&temp_pool[i], memory_order_relaxed) == NULL &&
+            atomic_compare_exchange_strong(&temp_pool[i], &expected, chunk)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static temp_chunk* temp_pool_pop()
 {
-    for (size_t i = 0; i < TEMP_INIT_COUNT; i++) {
-        if (!temp_used[i]) {  // Find an available allocator
-            temp_used[i] = true;
-            return (temp_allocator) { i, 0 };
+    for (size_t i = 0; i < TEMP_POOL_MAX; i++) {
+        if (atomic_load_explicit(&temp_pool[i], memory_order_relaxed) != NULL) {
+            temp_chunk* chunk = atomic_exchange(&temp_pool[i], NULL);
+            if (chunk != NULL) return chunk;
         }
     }
-    
-    fprintf(stderr, "Cannot allocate memory.\n");
-    exit(EXIT_FAILURE);
+    return NULL;
 }
 
+// Runs when a thread exits, its cached chunks go back to the shared pool
+static void temp_cache_flush(void* data)
+{
+    temp_chunk_cache* cache = data;
+    while (cache->count > 0) {
+        temp_chunk* chunk = cache->chunks[--cache->count];
+        if (!temp_pool_push(chunk)) {
+            munmap(chunk, chunk->capacity);
+        }
+    }
+}
 
-void temp_uninit(temp_allocator allocator)
+static void temp_cache_key_init()
+{
+    pthread_key_create(&temp_cache_key, temp_cache_flush);
+}
+
+static bool temp_cache_push(temp_chunk* chunk)
+{
+    if (temp_cache.count >= TEMP_CACHE_MAX) return false;
+
+    if (!temp_cache.registered) {
+        pthread_once(&temp_cache_key_once, temp_cache_key_init);
+        pthread_setspecific(temp_cache_key, &temp_cache);
+        temp_cache.registered = true;
+    }
+
+    temp_cache.chunks[temp_cache.count++] = chunk;
+    return true;
+}
+
+static temp_chunk* temp_cache_pop()
+{
+    if (temp_cache.count > 0) {
+        return temp_cache.chunks[--temp_cache.count];
+    }
+    return temp_pool_pop();
+}
+
+//
+// Telemetry registry, only touched when temp_stats_enable was called. Live
+// allocators are linked in a list and retired ones are folded into a group
+// named after them.
+//
+typedef struct {
+    const char* name;
+    size_t created;
+    size_t destroyed;
+    size_t peak_bytes;      // biggest peak of a single allocator
+    size_t alloc_count;
+    size_t free_count;
+    size_t size_classes[TEMP_SIZE_CLASS_COUNT];
+} temp_stats_group;
+
+typedef struct {
+    const char* file;
+    int line;
+    size_t count;
+    size_t bytes;
+} temp_callsite;
+
+static atomic_bool temp_stats_enabled = false;
+static atomic_bool temp_hugepages = false;
+static pthread_mutex_t temp_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct temp_arena* temp_live_arenas = NULL;
+static temp_stats_group temp_groups[TEMP_STATS_GROUPS] = {0};
+static temp_callsite temp_callsites[TEMP_CALLSITES_MAX] = {0};
+
+// The last group is "(other)", it collects every name that came after the
+// named groups ran out, so totals stay right and are not pinned on a name
+static temp_stats_group* temp_stats_group_get(temp_stats_group* groups, const char* name)
+{
+    for (size_t i = 0; i < TEMP_STATS_GROUPS - 1; i++) {
+        if (groups[i].name == NULL) {
+            groups[i].name = name;
+            return &groups[i];
+        }
+        if (strcmp(groups[i].name, name) == 0) {
+            return &groups[i];
+        }
+    }
+    groups[TEMP_STATS_GROUPS - 1].name = "(other)";
+    return &groups[TEMP_STATS_GROUPS - 1];
+}
+
+static void temp_stats_fold(temp_stats_group* group, struct temp_arena* arena)
 {
-    if (allocator.temp_index < TEMP_INIT_COUNT) {
-        temp_used[allocator.temp_index] = false;  // Mark as free
+    group->alloc_count += arena->alloc_count;
+    group->free_count += arena->free_count;
+    if (arena->peak_bytes > group->peak_bytes) group->peak_bytes = arena->peak_bytes;
+    for (size_t i = 0; i < TEMP_SIZE_CLASS_COUNT; i++) {
+        group->size_classes[i] += arena->size_classes[i];
     }
 }
 
-void* temp_alloc(temp_allocator allocator, size_t size)
+static void temp_callsite_record(const char* file, int line, size_t size)
 {
-    while (allocator.temp_count < TEMP_CAPACITY) {
-        block_header *block = (block_header *)&temp_memory[allocator.temp_index][allocator.temp_count];
+    size_t hash = ((uintptr_t)file >> 4) * 31 + (size_t)line;
 
-        if (!block->used && (allocator.temp_count + sizeof(block_header) + size <= TEMP_CAPACITY)) {
-            block->size = size;
-            block->used = true;
-            void* data_ptr = &temp_memory[allocator.temp_index][allocator.temp_count + sizeof(block_header)];
-            memset(data_ptr, 0, size); 
-            return &temp_memory[allocator.temp_index][allocator.temp_count + sizeof(block_header)];
+    pthread_mutex_lock(&temp_stats_lock);
+    for (size_t i = 0; i < TEMP_CALLSITES_MAX; i++) {
+        temp_callsite* site = &temp_callsites[(hash + i) % TEMP_CALLSITES_MAX];
+        if (site->file == NULL) {
+            site->file = file;
+            site->line = line;
+        }
+        if (site->file == file && site->line == line) {
+            site->count++;
+            site->bytes += size;
+            break;
         }
-        allocator.temp_count += sizeof(block_header) + block->size;
     }
+    pthread_mutex_unlock(&temp_stats_lock);
+}
+
+static size_t temp_size_class(size_t size)
+{
+    if (size >= TEMP_LARGE_THRESHOLD) return TEMP_SIZE_CLASS_COUNT - 1;
+
+    size_t class = 0;
+    while (((size_t)16 << class) < size) {
+        class++;
+    }
+    return class;
+}
+
+static size_t temp_page_align(size_t n)
+{
+    size_t page_size = temp_page_size();
+    return (n + page_size - 1) & ~(page_size - 1);
+}
+
+static void* temp_map(size_t size)
+{
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+//
+// Huge pages: try the hugetlb pool first, it fails unless the admin reserved
+// pages. Otherwise map a huge page aligned region and ask for transparent
+// huge pages. If neither works the region is still usable as normal memory.
+//
+static void* temp_map_huge(size_t size, temp_map_kind* kind)
+{
+#ifdef MAP_HUGETLB
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED) {
+        *kind = TEMP_MAP_HUGETLB;
+        return memory;
+    }
+#endif
+
+    // Over-map and cut the ends off so the region starts on a huge page
+    uint8_t* raw = temp_map(size + TEMP_HUGE_PAGE_SIZE);
+    if (raw == NULL) return NULL;
 
-    return NULL;  // No free space
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)raw + TEMP_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(TEMP_HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    size_t tail = (size_t)(raw + size + TEMP_HUGE_PAGE_SIZE - (aligned + size));
+    if (tail > 0) {
+        munmap(aligned + size, tail);
+    }
+
+    *kind = TEMP_MAP_NORMAL;
+#ifdef MADV_HUGEPAGE
+    if (madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+        *kind = TEMP_MAP_THP;
+    }
+#endif
+    return aligned;
 }
 
-void* temp_realloc(temp_allocator allocator, void* ptr, size_t new_size)
+// Map at least `*size` bytes, big regions are rounded up to whole huge
+// pages when huge pages are enabled
+static void* temp_map_region(size_t* size, temp_map_kind* kind)
+{
+    *kind = TEMP_MAP_NORMAL;
+
+    if (*size >= TEMP_HUGE_PAGE_SIZE && atomic_load_explicit(&temp_hugepages, memory_order_relaxed)) {
+        size_t huge_size = (*size + TEMP_HUGE_PAGE_SIZE - 1) & ~(size_t)(TEMP_HUGE_PAGE_SIZE - 1);
+        void* memory = temp_map_huge(huge_size, kind);
+        if (memory != NULL) {
+            *size = huge_size;
+            return memory;
+        }
+    }
+
+    return temp_map(*size);
+}
+
+// Give the pages past `keep` back to the OS, they read back as zeroes
+static void temp_chunk_trim(temp_chunk* chunk, size_t keep)
+{
+    // hugetlb mappings can only be dropped in whole huge pages
+    size_t page_size = chunk->kind == TEMP_MAP_HUGETLB ? TEMP_HUGE_PAGE_SIZE : temp_page_size();
+    size_t from = (keep + page_size - 1) & ~(page_size - 1);
+    size_t to = (chunk->dirty + page_size - 1) & ~(page_size - 1);
+    if (to > chunk->capacity) to = chunk->capacity;
+
+    if (from < to) {
+        madvise((uint8_t*)chunk + from, to - from, MADV_DONTNEED);
+        chunk->dirty = from;
+    }
+}
+
+static temp_chunk* temp_chunk_new(size_t capacity, size_t position)
+{
+    temp_chunk* chunk = NULL;
+
+    if (capacity == TEMP_CHUNK_MIN_SIZE) {
+        chunk = temp_cache_pop();
+    }
+
+    if (chunk == NULL) {
+        temp_map_kind kind;
+        chunk = temp_map_region(&capacity, &kind);
+        if (chunk == NULL) return NULL;
+        chunk->kind = kind;
+        chunk->dirty = TEMP_CHUNK_HEADER;
+    }
+
+    chunk->prev = NULL;
+    chunk->capacity = capacity;
+    chunk->base = TEMP_CHUNK_HEADER;
+    chunk->used = TEMP_CHUNK_HEADER;
+    chunk->position = position;
+    return chunk;
+}
+
+static void temp_chunk_release(temp_chunk* chunk)
+{
+    if (chunk->capacity == TEMP_CHUNK_MIN_SIZE) {
+        temp_chunk_trim(chunk, TEMP_KEEP_DIRTY);
+        if (temp_cache_push(chunk) || temp_pool_push(chunk)) return;
+    }
+    munmap(chunk, chunk->capacity);
+}
+
+static size_t temp_position(struct temp_arena* arena)
+{
+    temp_chunk* chunk = arena->current;
+    return chunk->position + chunk->used - chunk->base;
+}
+
+static void temp_note_alloc(struct temp_arena* arena, size_t size, const char* file, int line)
+{
+    arena->alloc_count++;
+    arena->size_classes[temp_size_class(size)]++;
+
+    size_t footprint = temp_position(arena) + arena->large_bytes;
+    if (footprint > arena->peak_bytes) {
+        arena->peak_bytes = footprint;
+    }
+
+    if (file != NULL && atomic_load_explicit(&temp_stats_enabled, memory_order_relaxed)) {
+        temp_callsite_record(file, line, size);
+    }
+}
+
+static temp_chunk* temp_arena_grow(struct temp_arena* arena)
+{
+    temp_chunk* chunk = temp_chunk_new(arena->next_chunk_size, temp_position(arena));
+    if (chunk == NULL) return NULL;
+
+    chunk->prev = arena->current;
+    arena->current = chunk;
+    arena->reserved_bytes += chunk->capacity;
+    if (arena->next_chunk_size < TEMP_CHUNK_MAX_SIZE) {
+        arena->next_chunk_size *= 2;
+    }
+    return chunk;
+}
+
+// Release the current chunk and step back to the previous one
+static void temp_arena_shrink(struct temp_arena* arena)
+{
+    temp_chunk* chunk = arena->current;
+    arena->current = chunk->prev;
+    arena->reserved_bytes -= chunk->capacity;
+    temp_chunk_release(chunk);
+}
+
+static temp_large* temp_large_from_block(block_header* block)
+{
+    return (temp_large*)((uint8_t*)block - TEMP_LARGE_HEADER);
+}
+
+static size_t temp_block_size(block_header* block)
+{
+    if (block->large) {
+        return temp_large_from_block(block)->map_size - TEMP_LARGE_HEADER - sizeof(block_header);
+    }
+    return block->size;
+}
+
+static void* temp_alloc_large(struct temp_arena* arena, size_t size)
+{
+    size_t map_size = temp_page_align(TEMP_LARGE_HEADER + sizeof(block_header) + size);
+    temp_map_kind kind;
+    temp_large* large = temp_map_region(&map_size, &kind);
+    if (large == NULL) return NULL;
+
+    large->arena = arena;
+    large->kind = kind;
+    large->map_size = map_size;
+    large->seq = ++arena->large_seq;
+    arena->reserved_bytes += map_size;
+    arena->large_bytes += map_size;
+    large->prev = NULL;
+    large->next = arena->large;
+    if (arena->large != NULL) {
+        arena->large->prev = large;
+    }
+    arena->large = large;
+
+    block_header* block = (block_header*)((uint8_t*)large + TEMP_LARGE_HEADER);
+    block->size = 0;
+    block->used = true;
+    block->large = true;
+    block->arena = arena;
+    return block + 1; // Fresh mappings are already zeroed
+}
+
+static void temp_large_release(temp_large* large)
+{
+    large->arena->reserved_bytes -= large->map_size;
+    large->arena->large_bytes -= large->map_size;
+
+    if (large->prev != NULL) {
+        large->prev->next = large->next;
+    } else {
+        large->arena->large = large->next;
+    }
+    if (large->next != NULL) {
+        large->next->prev = large->prev;
+    }
+    munmap(large, large->map_size);
+}
+
+// Grow a large block by remapping it, the kernel moves the pages instead of
+// copying them. Huge page mappings keep the copying path.
+static void* temp_large_grow(temp_large* large, size_t size)
+{
+    if (large->kind != TEMP_MAP_NORMAL) return NULL;
+
+    size_t map_size = temp_page_align(TEMP_LARGE_HEADER + sizeof(block_header) + size);
+    temp_large* moved = mremap(large, large->map_size, map_size, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) return NULL;
+
+    struct temp_arena* arena = moved->arena;
+    arena->reserved_bytes += map_size - moved->map_size;
+    arena->large_bytes += map_size - moved->map_size;
+    moved->map_size = map_size;
+
+    if (moved->prev != NULL) {
+        moved->prev->next = moved;
+    } else {
+        arena->large = moved;
+    }
+    if (moved->next != NULL) {
+        moved->next->prev = moved;
+    }
+    return (uint8_t*)moved + TEMP_LARGE_HEADER + sizeof(block_header);
+}
+
+temp_allocator temp_init()
+{
+    temp_chunk* chunk = temp_chunk_new(TEMP_CHUNK_MIN_SIZE, 0);
+    if (chunk == NULL) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The arena bookkeeping lives at the start of its own first chunk
+    struct temp_arena* arena = (struct temp_arena*)((uint8_t*)chunk + chunk->base);
+    memset(arena, 0, sizeof(*arena));
+    chunk->base += TEMP_ALIGN_UP(sizeof(struct temp_arena));
+    chunk->used = chunk->base;
+    if (chunk->dirty < chunk->used) chunk->dirty = chunk->used;
+
+    arena->first = chunk;
+    arena->current = chunk;
+    arena->next_chunk_size = TEMP_CHUNK_MIN_SIZE * 2;
+    arena->name = "unnamed";
+    arena->reserved_bytes = chunk->capacity;
+
+    if (atomic_load_explicit(&temp_stats_enabled, memory_order_relaxed)) {
+        pthread_mutex_lock(&temp_stats_lock);
+        arena->registered = true;
+        arena->stats_next = temp_live_arenas;
+        if (temp_live_arenas != NULL) temp_live_arenas->stats_prev = arena;
+        temp_live_arenas = arena;
+        pthread_mutex_unlock(&temp_stats_lock);
+    }
+
+    return (temp_allocator) { arena };
+}
+
+void temp_uninit(temp_allocator allocator)
+{
+    struct temp_arena* arena = allocator.arena;
+    if (arena == NULL) return;
+
+    if (arena->registered) {
+        pthread_mutex_lock(&temp_stats_lock);
+        if (arena->stats_prev != NULL) {
+            arena->stats_prev->stats_next = arena->stats_next;
+        } else {
+            temp_live_arenas = arena->stats_next;
+        }
+        if (arena->stats_next != NULL) {
+            arena->stats_next->stats_prev = arena->stats_prev;
+        }
+
+        temp_stats_group* group = temp_stats_group_get(temp_groups, arena->name);
+        group->created++;
+        group->destroyed++;
+        temp_stats_fold(group, arena);
+        pthread_mutex_unlock(&temp_stats_lock);
+    }
+
+    while (arena->large != NULL) {
+        temp_large_release(arena->large);
+    }
+
+    temp_chunk* first = arena->first;
+    temp_chunk* chunk = arena->current;
+    while (chunk != first) {
+        temp_chunk* prev = chunk->prev;
+        temp_chunk_release(chunk);
+        chunk = prev;
+    }
+    temp_chunk_release(first);
+}
+
+void* temp_alloc_at(temp_allocator allocator, size_t size, const char* file, int line)
+{
+    struct temp_arena* arena = allocator.arena;
+    size_t data_size = TEMP_ALIGN_UP(size == 0 ? 1 : size);
+
+    if (data_size >= TEMP_LARGE_THRESHOLD) {
+        void* data = temp_alloc_large(arena, size);
+        if (data != NULL) temp_note_alloc(arena, size, file, line);
+        return data;
+    }
+
+    size_t bin = data_size / TEMP_ALIGNMENT - 1;
+    if (bin < TEMP_BIN_COUNT && arena->bins[bin] != NULL) {
+        block_header* block = arena->bins[bin];
+        arena->bins[bin] = *(block_header**)(block + 1);
+        block->used = true;
+        memset(block + 1, 0, block->size);
+        temp_note_alloc(arena, size, file, line);
+        return block + 1;
+    }
+
+    temp_chunk* chunk = arena->current;
+    size_t block_size = sizeof(block_header) + data_size;
+    if (chunk->used + block_size > chunk->capacity) {
+        chunk = temp_arena_grow(arena);
+        if (chunk == NULL) return NULL;  // No free space
+    }
+
+    block_header* block = (block_header*)((uint8_t*)chunk + chunk->used);
+    block->size = (uint32_t)data_size;
+    block->used = true;
+    block->large = false;
+    block->arena = arena;
+
+    // Only memory below the high-water mark can hold stale data
+    size_t offset = chunk->used + sizeof(block_header);
+    if (offset < chunk->dirty) {
+        size_t stale = chunk->dirty - offset;
+        memset(block + 1, 0, stale < data_size ? stale : data_size);
+    }
+
+    chunk->used += block_size;
+    if (chunk->used > chunk->dirty) chunk->dirty = chunk->used;
+
+    temp_note_alloc(arena, size, file, line);
+    return block + 1;
+}
+
+void* temp_realloc_at(temp_allocator allocator, void* ptr, size_t new_size, const char* file, int line)
 {
     if (ptr == NULL) {
-        return temp_alloc(allocator, new_size);
+        return temp_alloc_at(allocator, new_size, file, line);
     }
 
-    block_header *header = (block_header *)((uint8_t *)ptr - sizeof(block_header));
+    block_header *header = (block_header *)ptr - 1;
+    size_t old_size = temp_block_size(header);
 
-    if (new_size <= header->size) {
+    if (new_size <= old_size) {
         return ptr;  // No need to allocate a new block if it fits
     }
 
-    void *new_ptr = temp_alloc(allocator, new_size);
+    // The newest block of the current chunk can grow in place, unless it
+    // started before the last checkpoint: rewinding would then cut it in two
+    temp_chunk* chunk = header->arena->current;
+    size_t data_size = TEMP_ALIGN_UP(new_size);
+    size_t block_position = chunk->position + ((uint8_t*)header - ((uint8_t*)chunk + chunk->base));
+    if (!header->large && data_size < TEMP_LARGE_THRESHOLD &&
+        (uint8_t*)ptr + header->size == (uint8_t*)chunk + chunk->used &&
+        block_position >= header->arena->saved_position &&
+        chunk->used - header->size + data_size <= chunk->capacity) {
+        size_t offset = chunk->used;
+        chunk->used += data_size - header->size;
+        header->size = (uint32_t)data_size;
+
+        if (offset < chunk->dirty) {
+            memset((uint8_t*)chunk + offset, 0, (chunk->dirty < chunk->used ? chunk->dirty : chunk->used) - offset);
+        }
+        if (chunk->used > chunk->dirty) chunk->dirty = chunk->used;
+        temp_note_alloc(header->arena, new_size, file, line);
+        return ptr;
+    }
+
+    if (header->large) {
+        void* grown = temp_large_grow(temp_large_from_block(header), new_size);
+        if (grown != NULL) {
+            temp_note_alloc(allocator.arena, new_size, file, line);
+            return grown;
+        }
+    }
+
+    void *new_ptr = temp_alloc_at(allocator, new_size, file, line);
     if (new_ptr) {
-        memcpy(new_ptr, ptr, header->size);  // Copy old data
+        memcpy(new_ptr, ptr, old_size);  // Copy old data
         temp_free(ptr);
     }
 
     return new_ptr;
 }
 
-char* temp_strdup(temp_allocator allocator, const char *cstr)
+void* temp_da_realloc(void* arena, void* ptr, size_t size)
+{
+    return temp_realloc_at((temp_allocator){ arena }, ptr, size, NULL, 0);
+}
+
+void temp_da_free(void* arena, void* ptr)
+{
+    (void)arena;
+    temp_free(ptr);
+}
+
+char* temp_strdup_at(temp_allocator allocator, const char *cstr, const char* file, int line)
 {
     size_t n = strlen(cstr);
-    char *result = temp_alloc(allocator, n + 1);
+    char *result = temp_alloc_at(allocator, n + 1, file, line);
     if (result) {
         memcpy(result, cstr, n);
         result[n] = '\0';
@@ -89,35 +694,315 @@ char* temp_strdup(temp_allocator allocator, const char *cstr)
 
 void temp_reset(temp_allocator allocator)
 {
-    allocator.temp_count = 0;
+    struct temp_arena* arena = allocator.arena;
+
+    while (arena->large != NULL) {
+        temp_large_release(arena->large);
+    }
+
+    while (arena->current != arena->first) {
+        temp_arena_shrink(arena);
+    }
+
+    arena->first->used = arena->first->base;
+    temp_chunk_trim(arena->first, TEMP_KEEP_DIRTY);
+
+    arena->next_chunk_size = TEMP_CHUNK_MIN_SIZE * 2;
+    arena->saved_position = 0;
+    memset(arena->bins, 0, sizeof(arena->bins));
 }
 
-size_t temp_save(temp_allocator allocator)
+temp_checkpoint temp_save(temp_allocator allocator)
 {
-    return allocator.temp_count;
+    struct temp_arena* arena = allocator.arena;
+    arena->saved_position = temp_position(arena);
+    return (temp_checkpoint) {
+        .position = arena->saved_position,
+        .large_seq = arena->large_seq,
+    };
 }
 
-void temp_rewind(temp_allocator allocator, size_t checkpoint)
+// Whether a free block lies below the bump offset of one of the chunks the
+// arena still owns
+static bool temp_arena_holds(struct temp_arena* arena, block_header* block)
 {
-    allocator.temp_count = checkpoint;
+    for (temp_chunk* chunk = arena->current; chunk != NULL; chunk = chunk->prev) {
+        uint8_t* start = (uint8_t*)chunk + chunk->base;
+        if ((uint8_t*)block >= start && (uint8_t*)block < (uint8_t*)chunk + chunk->used) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// O(1) for the bump part, chunks and large blocks created after the
+// checkpoint are released one by one and the free lists are filtered.
+void temp_rewind(temp_allocator allocator, temp_checkpoint checkpoint)
+{
+    struct temp_arena* arena = allocator.arena;
+
+    while (arena->large != NULL && arena->large->seq > checkpoint.large_seq) {
+        temp_large_release(arena->large);
+    }
+
+    while (arena->current != arena->first && arena->current->position > checkpoint.position) {
+        temp_arena_shrink(arena);
+    }
+
+    temp_chunk* chunk = arena->current;
+    size_t used = chunk->base + (checkpoint.position - chunk->position);
+    if (used < chunk->used) {
+        chunk->used = used;
+    }
+
+    arena->saved_position = checkpoint.position;
+
+    // Blocks freed before the checkpoint stay on the free lists, the ones
+    // past it were just released or will be handed out again by the bump
+    for (size_t bin = 0; bin < TEMP_BIN_COUNT; bin++) {
+        block_header** link = &arena->bins[bin];
+        while (*link != NULL) {
+            block_header* block = *link;
+            block_header** next = (block_header**)(block + 1);
+            if (temp_arena_holds(arena, block)) {
+                link = next;
+            } else {
+                *link = *next;
+            }
+        }
+    }
 }
 
 void temp_free(void* ptr)
 {
     if (ptr == NULL) return;
 
-    block_header *header = (block_header *)((uint8_t *)ptr - sizeof(block_header));
+    block_header *header = (block_header *)ptr - 1;
+    if (!header->used) return;
+
+    header->arena->free_count++;
+
+    if (header->large) {
+        temp_large_release(temp_large_from_block(header));
+        return;
+    }
+
     header->used = false;  // Mark as free
+
+    size_t bin = header->size / TEMP_ALIGNMENT - 1;
+    if (bin < TEMP_BIN_COUNT) {
+        *(block_header**)ptr = header->arena->bins[bin];
+        header->arena->bins[bin] = header;
+    }
 }
 
 void print_memory(temp_allocator allocator, FILE* fp)
 {
-    size_t i = 0;
+    struct temp_arena* arena = allocator.arena;
+
     fprintf(fp, "Memory Dump:\n");
-    while (i < TEMP_CAPACITY) {
-        block_header *block = (block_header *)&temp_memory[allocator.temp_index][i];
-        fprintf(fp, "[%s | size: %lu]\n", block->used ? "USED" : "FREE", block->size);
-        i += sizeof(block_header) + block->size;
-        if (i >= TEMP_CAPACITY) break;
+    for (temp_chunk* chunk = arena->current; chunk != NULL; chunk = chunk->prev) {
+        fprintf(fp, "Chunk %p [used: %lu | capacity: %lu]\n", (void*)chunk, chunk->used, chunk->capacity);
+
+        size_t i = chunk->base;
+        while (i < chunk->used) {
+            block_header *block = (block_header *)((uint8_t*)chunk + i);
+            fprintf(fp, "[%s | size: %u]\n", block->used ? "USED" : "FREE", block->size);
+            i += sizeof(block_header) + block->size;
+        }
+    }
+
+    for (temp_large* large = arena->large; large != NULL; large = large->next) {
+        fprintf(fp, "[LARGE | size: %lu]\n", large->map_size - TEMP_LARGE_HEADER - sizeof(block_header));
+    }
+}
+
+void temp_set_name(temp_allocator allocator, const char* name)
+{
+    allocator.arena->name = name;
+}
+
+temp_stats temp_get_stats(temp_allocator allocator)
+{
+    struct temp_arena* arena = allocator.arena;
+
+    temp_stats stats = {
+        .peak_bytes = arena->peak_bytes,
+        .reserved_bytes = arena->reserved_bytes,
+        .alloc_count = arena->alloc_count,
+        .free_count = arena->free_count,
+    };
+    memcpy(stats.size_classes, arena->size_classes, sizeof(stats.size_classes));
+
+    for (temp_chunk* chunk = arena->current; chunk != NULL; chunk = chunk->prev) {
+        if (chunk->kind == TEMP_MAP_HUGETLB) stats.huge_pages += chunk->capacity / TEMP_HUGE_PAGE_SIZE;
+        if (chunk->kind == TEMP_MAP_THP) stats.thp_bytes += chunk->capacity;
+
+        size_t run = 0;   // Adjacent free blocks form one free extent
+        size_t i = chunk->base;
+        while (i < chunk->used) {
+            block_header *block = (block_header *)((uint8_t*)chunk + i);
+            if (block->used) {
+                stats.live_bytes += block->size;
+                run = 0;
+            } else {
+                run += run == 0 ? block->size : sizeof(block_header) + block->size;
+                stats.free_bytes += block->size;
+                if (run > stats.largest_free) stats.largest_free = run;
+            }
+            i += sizeof(block_header) + block->size;
+        }
+    }
+
+    // Only the tail of the current chunk is still reachable by the bump pointer
+    temp_chunk* chunk = arena->current;
+    if (chunk->capacity - chunk->used > sizeof(block_header)) {
+        size_t tail = chunk->capacity - chunk->used - sizeof(block_header);
+        stats.free_bytes += tail;
+        if (tail > stats.largest_free) stats.largest_free = tail;
+    }
+
+    for (temp_large* large = arena->large; large != NULL; large = large->next) {
+        stats.live_bytes += large->map_size - TEMP_LARGE_HEADER - sizeof(block_header);
+        if (large->kind == TEMP_MAP_HUGETLB) stats.huge_pages += large->map_size / TEMP_HUGE_PAGE_SIZE;
+        if (large->kind == TEMP_MAP_THP) stats.thp_bytes += large->map_size;
+    }
+
+    return stats;
+}
+
+// 0 when all free space is one extent, close to 1 when it is scattered
+double temp_fragmentation(temp_stats stats)
+{
+    if (stats.free_bytes == 0) return 0.0;
+    return 1.0 - (double)stats.largest_free / (double)stats.free_bytes;
+}
+
+void temp_stats_enable()
+{
+    atomic_store(&temp_stats_enabled, true);
+}
+
+void temp_hugepages_enable()
+{
+    atomic_store(&temp_hugepages, true);
+}
+
+// Transparent huge pages actually backing the process, in kB
+static long temp_anon_huge_kb()
+{
+    FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+    if (fp == NULL) return -1;
+
+    long kb = -1;
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    }
+    fclose(fp);
+    return kb;
+}
+
+static int temp_callsite_compare(const void* a, const void* b)
+{
+    const temp_callsite* x = a;
+    const temp_callsite* y = b;
+    if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+    return 0;
+}
+
+size_t temp_total_allocs()
+{
+    size_t total = 0;
+
+    pthread_mutex_lock(&temp_stats_lock);
+    for (size_t i = 0; i < TEMP_STATS_GROUPS; i++) {
+        total += temp_groups[i].alloc_count;
+    }
+    for (struct temp_arena* arena = temp_live_arenas; arena != NULL; arena = arena->stats_next) {
+        total += arena->alloc_count;
+    }
+    pthread_mutex_unlock(&temp_stats_lock);
+
+    return total;
+}
+
+// Not synchronized with allocators used by other threads, call it once
+// they are done (typically at exit).
+void temp_print_stats(FILE* fp)
+{
+    static const char* class_names[TEMP_SIZE_CLASS_COUNT] = {
+        "16", "32", "64", "128", "256", "512", "1K", "2K", "4K", "8K", "16K", "32K", "large",
+    };
+
+    pthread_mutex_lock(&temp_stats_lock);
+
+    temp_stats_group groups[TEMP_STATS_GROUPS];
+    memcpy(groups, temp_groups, sizeof(groups));
+    temp_stats live[TEMP_STATS_GROUPS] = {0};
+
+    for (struct temp_arena* arena = temp_live_arenas; arena != NULL; arena = arena->stats_next) {
+        temp_stats_group* group = temp_stats_group_get(groups, arena->name);
+        group->created++;
+        temp_stats_fold(group, arena);
+
+        temp_stats stats = temp_get_stats((temp_allocator) { arena });
+        temp_stats* sum = &live[group - groups];
+        sum->live_bytes += stats.live_bytes;
+        sum->reserved_bytes += stats.reserved_bytes;
+        sum->free_bytes += stats.free_bytes;
+        sum->huge_pages += stats.huge_pages;
+        sum->thp_bytes += stats.thp_bytes;
+        if (stats.largest_free > sum->largest_free) sum->largest_free = stats.largest_free;
+    }
+
+    fprintf(fp, "==== Memory stats ====\n");
+    fprintf(fp, "%-16s %15s %12s %12s %12s %10s %10s %6s\n",
+            "allocator", "live/all", "live bytes", "peak bytes", "reserved", "allocs", "frees", "frag");
+
+    for (size_t i = 0; i < TEMP_STATS_GROUPS; i++) {
+        temp_stats_group* group = &groups[i];
+        if (group->name == NULL) continue;
+        fprintf(fp, "%-16s %7zu/%-7zu %12zu %12zu %12zu %10zu %10zu %5.1f%%\n",
+                group->name, group->created - group->destroyed, group->created,
+                live[i].live_bytes, group->peak_bytes, live[i].reserved_bytes,
+                group->alloc_count, group->free_count, temp_fragmentation(live[i]) * 100.0);
+
+        fprintf(fp, "    size classes:");
+        for (size_t c = 0; c < TEMP_SIZE_CLASS_COUNT; c++) {
+            if (group->size_classes[c] > 0) {
+                fprintf(fp, " <=%s:%zu", class_names[c], group->size_classes[c]);
+            }
+        }
+        fprintf(fp, "\n");
+
+        if (live[i].huge_pages > 0 || live[i].thp_bytes > 0) {
+            fprintf(fp, "    huge pages: %zu hugetlb, %zu bytes advised for THP\n",
+                    live[i].huge_pages, live[i].thp_bytes);
+        }
+    }
+
+    if (atomic_load(&temp_hugepages)) {
+        fprintf(fp, "huge pages: AnonHugePages %ld kB\n", temp_anon_huge_kb());
+    }
+
+    size_t callsite_count = 0;
+    temp_callsite* callsites = malloc(sizeof(temp_callsites));
+    for (size_t i = 0; callsites != NULL && i < TEMP_CALLSITES_MAX; i++) {
+        if (temp_callsites[i].file != NULL) {
+            callsites[callsite_count++] = temp_callsites[i];
+        }
+    }
+
+    pthread_mutex_unlock(&temp_stats_lock);
+
+    if (callsite_count > 0) {
+        qsort(callsites, callsite_count, sizeof(*callsites), temp_callsite_compare);
+        fprintf(fp, "==== Top allocation sites ====\n");
+        for (size_t i = 0; i < callsite_count && i < 20; i++) {
+            fprintf(fp, "%12zu bytes %10zu allocs  %s:%d\n",
+                    callsites[i].bytes, callsites[i].count, callsites[i].file, callsites[i].line);
+        }
     }
+    free(callsites);
 }
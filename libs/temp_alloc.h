@@ -3,22 +3,93 @@
 #include <stddef.h>
 #include <stdio.h>
 
+struct temp_arena;
+
+// A temp_allocator is a handle to a growable chain of mmap'ed chunks, so it
+// can be passed around by value like before. Allocators are safe to create
+// and destroy from any thread, but each one must only be used (including
+// temp_free of its blocks) by one thread at a time.
 typedef struct {
-    size_t temp_index;
-    size_t temp_count;
+    struct temp_arena* arena;
 } temp_allocator;
 
+// Everything allocated after a checkpoint is released by rewinding to it.
+// Checkpoints nest: rewinding to an outer one also drops the inner ones.
+// A block from before the last checkpoint is copied when it grows, so the
+// grown block is released by the rewind like any other new allocation.
+typedef struct {
+    size_t position;
+    size_t large_seq;
+} temp_checkpoint;
+
+// Allocation counts are bucketed by power of two from 16 bytes up to the
+// large-block threshold, the last class counts large blocks.
+#define TEMP_SIZE_CLASS_COUNT (13)
+
+typedef struct {
+    size_t live_bytes;      // bytes in blocks that are still in use
+    size_t peak_bytes;      // high-water mark of the allocator footprint
+    size_t reserved_bytes;  // bytes currently mapped from the OS
+    size_t free_bytes;      // reusable space: freed blocks and the tail of the current chunk
+    size_t largest_free;    // biggest contiguous piece of free_bytes
+    size_t alloc_count;
+    size_t free_count;
+    size_t size_classes[TEMP_SIZE_CLASS_COUNT];
+    size_t huge_pages;      // 2MB pages mapped with MAP_HUGETLB
+    size_t thp_bytes;       // bytes advised with MADV_HUGEPAGE
+} temp_stats;
+
 temp_allocator temp_init();
 void temp_uninit(temp_allocator allocator);
 
-void* temp_alloc(temp_allocator allocator, size_t size);
-void* temp_realloc(temp_allocator allocator, void* ptr, size_t new_size);
+void* temp_alloc_at(temp_allocator allocator, size_t size, const char* file, int line);
+void* temp_realloc_at(temp_allocator allocator, void* ptr, size_t new_size, const char* file, int line);
+char* temp_strdup_at(temp_allocator allocator, const char *cstr, const char* file, int line);
 void temp_free(void* ptr);
 
-char* temp_strdup(temp_allocator allocator, const char *cstr);
+// Build with -DTEMP_TRACK_CALLSITES to attribute allocations to their
+// callers in temp_print_stats
+#ifdef TEMP_TRACK_CALLSITES
+    #define temp_alloc(allocator, size)        temp_alloc_at(allocator, size, __FILE__, __LINE__)
+    #define temp_realloc(allocator, ptr, size) temp_realloc_at(allocator, ptr, size, __FILE__, __LINE__)
+    #define temp_strdup(allocator, cstr)       temp_strdup_at(allocator, cstr, __FILE__, __LINE__)
+#else
+    #define temp_alloc(allocator, size)        temp_alloc_at(allocator, size, NULL, 0)
+    #define temp_realloc(allocator, ptr, size) temp_realloc_at(allocator, ptr, size, NULL, 0)
+    #define temp_strdup(allocator, cstr)       temp_strdup_at(allocator, cstr, NULL, 0)
+#endif
+
+// Backs small-buffer dynamic arrays (sda_* in dynamic_array.h) with a
+// temp_allocator: sda_init_with_allocator(&da, temp_da_allocator(allocator))
+void* temp_da_realloc(void* arena, void* ptr, size_t size);
+void temp_da_free(void* arena, void* ptr);
+#define temp_da_allocator(allocator) ((da_allocator){ temp_da_realloc, temp_da_free, (allocator).arena })
 
 void temp_reset(temp_allocator allocator);
-size_t temp_save(temp_allocator allocator);
-void temp_rewind(temp_allocator allocator, size_t checkpoint);
+temp_checkpoint temp_save(temp_allocator allocator);
+void temp_rewind(temp_allocator allocator, temp_checkpoint checkpoint);
+
+// Run the following block and release whatever it allocated in `allocator`.
+// Leaving the block with break, goto or return skips the rewind.
+#define temp_scope(allocator) \
+    for (temp_checkpoint _temp_cp = temp_save(allocator), *_temp_once = &_temp_cp; \
+         _temp_once != NULL; \
+         temp_rewind(allocator, _temp_cp), _temp_once = NULL)
 
 void print_memory(temp_allocator allocator, FILE* fp);
+
+// Telemetry. Every allocator keeps its own counters, temp_stats_enable
+// additionally registers allocators so temp_print_stats can report all of
+// them grouped by name. Call it before creating any allocator.
+void temp_set_name(temp_allocator allocator, const char* name);
+temp_stats temp_get_stats(temp_allocator allocator);
+double temp_fragmentation(temp_stats stats);
+void temp_stats_enable();
+void temp_print_stats(FILE* fp);
+// Allocations made so far by all registered allocators, live or destroyed
+size_t temp_total_allocs();
+
+// Back chunks and large blocks of 2MB or more with huge pages: MAP_HUGETLB
+// when the system has reserved pages, MADV_HUGEPAGE otherwise. Call it
+// before allocating.
+void temp_hugepages_enable();
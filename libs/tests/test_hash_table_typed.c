@@ -0,0 +1,161 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tests.h"
+#include "../hash_table_typed.h"
+
+#define KEYS 4096
+#define OPS (1 << 18)
+
+HT_DECLARE_U64(u64_table, int)
+HT_DECLARE_PTR(ptr_table, int)
+
+// Zero bytes everywhere but one position, the keys ht_to_char used to cut
+// short at the first zero byte
+typedef struct {
+    uint8_t bytes[12];
+} blob_key;
+
+HT_DECLARE_BLOB(blob_table, blob_key, int)
+
+// Keys spread over the whole 64-bit range, 0 included
+static uint64_t u64_key(int i)
+{
+    return (uint64_t)i * 0x9e3779b97f4a7c15ull;
+}
+
+// Random inserts, overwrites and deletes against a plain array that knows
+// which keys are present. Deletes leave tombstones, so this also covers
+// probing past them and rehashing a table full of them.
+static void test_u64_against_reference()
+{
+    static int reference[KEYS];
+    for (int i = 0; i < KEYS; i++) reference[i] = -1;
+    size_t present = 0;
+
+    u64_table table;
+    u64_table_init(&table);
+
+    for (int op = 0; op < OPS; op++) {
+        int i = test_rand() % KEYS;
+        uint64_t key = u64_key(i);
+
+        switch (test_rand() % 4) {
+        case 0: {
+            bool inserted;
+            int* value = u64_table_get_or_insert(&table, key, &inserted);
+            test_check(inserted == (reference[i] < 0), "key %d inserted %d", i, inserted);
+            test_check(inserted ? *value == 0 : *value == reference[i], "key %d value %d", i, *value);
+            if (inserted) present++;
+            *value = op;
+            reference[i] = op;
+            break;
+        }
+        case 1:
+            if (reference[i] < 0) present++;
+            u64_table_upsert(&table, key, op);
+            reference[i] = op;
+            break;
+        case 2: {
+            bool deleted = u64_table_delete(&table, key);
+            test_check(deleted == (reference[i] >= 0), "key %d deleted %d", i, deleted);
+            if (deleted) present--;
+            reference[i] = -1;
+            break;
+        }
+        default: {
+            int* value = u64_table_find(&table, key);
+            test_check((value != NULL) == (reference[i] >= 0), "key %d found %d", i, value != NULL);
+            if (value != NULL) test_check(*value == reference[i], "key %d value %d", i, *value);
+            break;
+        }
+        }
+        test_check(table.count == present, "count %zu, expected %zu", table.count, present);
+    }
+
+    for (int i = 0; i < KEYS; i++) {
+        int* value = u64_table_find(&table, u64_key(i));
+        test_check((value != NULL) == (reference[i] >= 0), "key %d found %d", i, value != NULL);
+        if (value != NULL) test_check(*value == reference[i], "key %d value %d", i, *value);
+    }
+
+    u64_table_free(&table);
+}
+
+static void test_ptr_keys()
+{
+    static char objects[KEYS];
+
+    ptr_table table;
+    ptr_table_init(&table);
+
+    for (int i = 0; i < KEYS; i++) ptr_table_upsert(&table, &objects[i], i);
+    test_check(table.count == KEYS, "count %zu", table.count);
+
+    // Neighbouring addresses differ in the low bits only
+    for (int i = 0; i < KEYS; i++) {
+        int* value = ptr_table_find(&table, &objects[i]);
+        test_check(value != NULL && *value == i, "object %d", i);
+    }
+    for (int i = 0; i < KEYS; i += 2) ptr_table_delete(&table, &objects[i]);
+    for (int i = 0; i < KEYS; i++) {
+        int* value = ptr_table_find(&table, &objects[i]);
+        test_check((value != NULL) == (i % 2 == 1), "object %d found %d", i, value != NULL);
+    }
+    test_check(ptr_table_find(&table, NULL) == NULL, "NULL found");
+
+    ptr_table_free(&table);
+}
+
+static blob_key blob_key_at(int position, uint8_t byte)
+{
+    blob_key key;
+    memset(&key, 0, sizeof(key));
+    key.bytes[position] = byte;
+    return key;
+}
+
+static void test_blob_keys_with_zero_bytes()
+{
+    blob_table table;
+    blob_table_init(&table);
+
+    // Every key starts with a zero byte unless position is 0, as strings
+    // they would all be empty
+    int value = 0;
+    for (int position = 0; position < (int)sizeof(blob_key); position++) {
+        for (int byte = 1; byte < 256; byte++) {
+            bool inserted;
+            *blob_table_get_or_insert(&table, blob_key_at(position, byte), &inserted) = value++;
+            test_check(inserted, "position %d byte %d", position, byte);
+        }
+    }
+    blob_table_upsert(&table, blob_key_at(0, 0), -1);
+    test_check(table.count == sizeof(blob_key) * 255 + 1, "count %zu", table.count);
+
+    value = 0;
+    for (int position = 0; position < (int)sizeof(blob_key); position++) {
+        for (int byte = 1; byte < 256; byte++) {
+            int* found = blob_table_find(&table, blob_key_at(position, byte));
+            test_check(found != NULL && *found == value, "position %d byte %d", position, byte);
+            value++;
+        }
+    }
+    int* zero = blob_table_find(&table, blob_key_at(0, 0));
+    test_check(zero != NULL && *zero == -1, "all-zero key");
+
+    // Only the last byte tells these apart
+    test_check(blob_table_delete(&table, blob_key_at(sizeof(blob_key) - 1, 7)), "delete");
+    test_check(blob_table_find(&table, blob_key_at(sizeof(blob_key) - 1, 7)) == NULL, "deleted key found");
+    test_check(blob_table_find(&table, blob_key_at(sizeof(blob_key) - 1, 8)) != NULL, "neighbour lost");
+
+    blob_table_free(&table);
+}
+
+void test_hash_table_typed()
+{
+    test_u64_against_reference();
+    test_ptr_keys();
+    test_blob_keys_with_zero_bytes();
+}
@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+#include "../string.h"
+
+#define TRIALS 20000
+#define MAX_COUNT 200
+
+// Spaces, digits and bytes with the high bit set, the classes the kernels
+// compare against and the bytes that turn negative in a signed compare
+static const char alphabet[] = {
+    ' ', '\t', '\n', '\r', '\v', '\f', '0', '5', '9', 'a', 'b', 'z', '\0',
+    (char)0x80, (char)0xA0, (char)0xE9, (char)0xFF,
+};
+
+// Most lengths sit next to the 16 and 32 byte blocks, where a kernel hands
+// the tail to the narrower one
+static size_t random_count()
+{
+    static const size_t edges[] = { 0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 96 };
+    switch (test_rand() % 3) {
+    case 0:
+        return test_rand() % (MAX_COUNT + 1);
+    default: {
+        size_t edge = edges[test_rand() % (sizeof(edges) / sizeof(edges[0]))];
+        size_t count = edge + test_rand() % 5;
+        return count < 2 ? count : count - 2;
+    }
+    }
+}
+
+static char random_byte(size_t classes)
+{
+    return alphabet[test_rand() % classes];
+}
+
+// The bytes are copied into an allocation of exactly their size, so a kernel
+// reading past the end trips a sanitizer or valgrind
+static char* random_bytes(size_t count, size_t classes)
+{
+    char* data = malloc(count > 0 ? count : 1);
+    for (size_t i = 0; i < count; i++) data[i] = random_byte(classes);
+    return data;
+}
+
+typedef struct {
+    size_t find_c;
+    size_t find_sv;
+    bool equal;
+    string_view trim;
+    size_t to_digit;
+} string_results;
+
+static string_results run_kernels(string_view haystack, char c, string_view needle, string_view other,
+                                  string_view spaced, string_view digits)
+{
+    return (string_results){
+        .find_c = sv_find_c(haystack, c),
+        .find_sv = sv_find_sv(haystack, needle),
+        .equal = sv_equal(haystack, other),
+        .trim = sv_trim(spaced),
+        .to_digit = sv_to_digit(digits),
+    };
+}
+
+// Every SIMD level must give the scalar kernels' answers on the same input
+void test_string()
+{
+    sv_kernel_level original = sv_kernel_get();
+    size_t classes = sizeof(alphabet);
+
+    for (int trial = 0; trial < TRIALS; trial++) {
+        size_t count = random_count();
+        char* haystack_data = random_bytes(count, classes);
+        string_view haystack = sv_from_parts(haystack_data, count);
+
+        char c = random_byte(classes);
+
+        // Needles are often cut from the haystack so that they match
+        size_t needle_count = test_rand() % 6 == 0 ? random_count() : test_rand() % 5;
+        char* needle_data = random_bytes(needle_count, 4);
+        if (needle_count <= count && test_rand() % 2) {
+            size_t start = test_rand() % (count - needle_count + 1);
+            memcpy(needle_data, haystack_data + start, needle_count);
+        }
+        string_view needle = sv_from_parts(needle_data, needle_count);
+
+        // Equal unless one byte is flipped, anywhere up to the last
+        char* other_data = malloc(count > 0 ? count : 1);
+        memcpy(other_data, haystack_data, count);
+        if (count > 0 && test_rand() % 2) other_data[test_rand() % count] ^= 1 << (test_rand() % 8);
+        string_view other = sv_from_parts(other_data, count);
+
+        // Space runs on both sides of a random middle
+        size_t spaced_count = random_count();
+        char* spaced_data = random_bytes(spaced_count, 6);
+        size_t middle = spaced_count > 0 ? test_rand() % spaced_count : 0;
+        size_t middle_count = test_rand() % 8;
+        for (size_t i = middle; i < spaced_count && i < middle + middle_count; i++) {
+            spaced_data[i] = random_byte(classes);
+        }
+        string_view spaced = sv_from_parts(spaced_data, spaced_count);
+
+        // Digits, sometimes with a non-digit inside the first 8 byte words
+        size_t digits_count = test_rand() % 40;
+        char* digits_data = malloc(digits_count > 0 ? digits_count : 1);
+        for (size_t i = 0; i < digits_count; i++) digits_data[i] = '0' + test_rand() % 10;
+        if (digits_count > 0 && test_rand() % 2) digits_data[test_rand() % digits_count] = random_byte(classes);
+        string_view digits = sv_from_parts(digits_data, digits_count);
+
+        sv_kernel_set(SV_KERNEL_SCALAR);
+        string_results expected = run_kernels(haystack, c, needle, other, spaced, digits);
+        test_check(expected.to_digit == sv_to_digit_scalar(digits), "trial %d, %zu digits", trial, digits_count);
+
+        for (sv_kernel_level level = SV_KERNEL_SSE2; level <= SV_KERNEL_AVX2; level++) {
+            if (sv_kernel_set(level) != level) break;
+            string_results got = run_kernels(haystack, c, needle, other, spaced, digits);
+
+            test_check(got.find_c == expected.find_c, "level %d, trial %d, count %zu: %zu, expected %zu",
+                       level, trial, count, got.find_c, expected.find_c);
+            test_check(got.find_sv == expected.find_sv, "level %d, trial %d, count %zu, needle %zu: %zu, expected %zu",
+                       level, trial, count, needle_count, got.find_sv, expected.find_sv);
+            test_check(got.equal == expected.equal, "level %d, trial %d, count %zu", level, trial, count);
+            test_check(got.trim.data == expected.trim.data && got.trim.count == expected.trim.count,
+                       "level %d, trial %d, count %zu: [%td, %zu), expected [%td, %zu)", level, trial, spaced_count,
+                       got.trim.data - spaced_data, got.trim.count, expected.trim.data - spaced_data, expected.trim.count);
+            test_check(got.to_digit == sv_to_digit_scalar(digits), "level %d, trial %d, %zu digits",
+                       level, trial, digits_count);
+        }
+
+        free(haystack_data);
+        free(needle_data);
+        free(other_data);
+        free(spaced_data);
+        free(digits_data);
+    }
+
+    sv_kernel_set(original);
+}
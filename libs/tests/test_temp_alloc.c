@@ -0,0 +1,129 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "../temp_alloc.h"
+
+static bool all_bytes(const uint8_t* data, size_t count, uint8_t byte)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (data[i] != byte) return false;
+    }
+    return true;
+}
+
+// A block from before a checkpoint is the newest one of its chunk. Growing
+// it in place would stretch it past the checkpoint, and the rewind would put
+// the bump offset back inside it, so it has to be copied instead.
+static void test_realloc_across_checkpoint()
+{
+    temp_allocator allocator = temp_init();
+
+    uint8_t* block = temp_alloc(allocator, 16);
+    memset(block, 0xAB, 16);
+    temp_checkpoint checkpoint = temp_save(allocator);
+    uint8_t* grown = temp_realloc(allocator, block, 256);
+    test_check(grown != block, "block from before the checkpoint grew in place");
+    test_check(all_bytes(grown, 16, 0xAB), "contents not copied");
+    temp_rewind(allocator, checkpoint);
+
+    // The bump offset is back at the end of the original block, the original
+    // block itself went to a free list from before the checkpoint
+    uint8_t* after = temp_alloc(allocator, 128);
+    test_check(after >= block + 16, "rewound allocation overlaps the original block");
+    test_check(temp_alloc(allocator, 16) == block, "original block not reused");
+
+    // Blocks made after the checkpoint still grow in place, 80 bytes does not
+    // come from the free list the first 16 byte block went to
+    checkpoint = temp_save(allocator);
+    uint8_t* scratch = temp_alloc(allocator, 80);
+    test_check(temp_realloc(allocator, scratch, 160) == scratch, "block past the checkpoint moved");
+    temp_rewind(allocator, checkpoint);
+
+    temp_uninit(allocator);
+}
+
+// Rewinding keeps the blocks freed before the checkpoint reusable and drops
+// the ones past it
+static void test_free_lists_across_checkpoint()
+{
+    temp_allocator allocator = temp_init();
+
+    uint8_t* kept = temp_alloc(allocator, 48);
+    temp_alloc(allocator, 16);
+    temp_free(kept);
+
+    temp_checkpoint checkpoint = temp_save(allocator);
+    uint8_t* dropped = temp_alloc(allocator, 32);
+    temp_alloc(allocator, 16);
+    temp_free(dropped);
+    temp_rewind(allocator, checkpoint);
+
+    test_check(temp_alloc(allocator, 48) == kept, "block freed before the checkpoint lost");
+
+    // The dropped block's space is bump memory again, a block of another size
+    // lands on it while the 32 byte free list is empty
+    uint8_t* bumped = temp_alloc(allocator, 64);
+    test_check(bumped == dropped, "bump position not rewound");
+    uint8_t* other = temp_alloc(allocator, 32);
+    test_check(other != dropped, "free list kept a block past the checkpoint");
+    memset(bumped, 0xEE, 64);
+    test_check(all_bytes(other, 32, 0), "block from the free list overlaps a live one");
+
+    temp_uninit(allocator);
+}
+
+// More allocator names than temp_print_stats has groups for: the extra ones
+// are reported together under "(other)" and the named groups keep their own
+// counts
+static void test_stats_group_overflow()
+{
+    enum { NAMES = 40 };
+    static char names[NAMES][16];
+
+    temp_stats_enable();
+    for (int i = 0; i < NAMES; i++) {
+        snprintf(names[i], sizeof(names[i]), "overflow_%d", i);
+        temp_allocator allocator = temp_init();
+        temp_set_name(allocator, names[i]);
+        temp_alloc(allocator, 16);
+        temp_uninit(allocator);
+    }
+
+    FILE* fp = tmpfile();
+    temp_print_stats(fp);
+    rewind(fp);
+
+    size_t named = 0;
+    size_t other_created = 0;
+    size_t other_allocs = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char name[64];
+        size_t live, created, live_bytes, peak, reserved, allocs;
+        if (sscanf(line, "%63s %zu/%zu %zu %zu %zu %zu", name, &live, &created, &live_bytes, &peak, &reserved, &allocs) != 7) {
+            continue;
+        }
+        if (strcmp(name, "(other)") == 0) {
+            other_created = created;
+            other_allocs = allocs;
+        } else if (strncmp(name, "overflow_", 9) == 0) {
+            named++;
+            test_check(created == 1 && allocs == 1, "%s: %zu allocators, %zu allocs", name, created, allocs);
+        }
+    }
+    fclose(fp);
+
+    test_check(named + other_created == NAMES, "%zu named, %zu in (other)", named, other_created);
+    test_check(other_created > 0 && other_allocs == other_created, "(other): %zu allocators, %zu allocs",
+               other_created, other_allocs);
+}
+
+void test_temp_alloc()
+{
+    test_realloc_across_checkpoint();
+    test_free_lists_across_checkpoint();
+    test_stats_group_overflow();
+}
@@ -0,0 +1,61 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+
+static const test tests[] = {
+    { "hash_table_typed", test_hash_table_typed },
+    { "string",           test_string },
+    { "temp_alloc",       test_temp_alloc },
+};
+
+// Failures past this many per test are only counted
+#define TEST_MAX_REPORTS 10
+
+static size_t test_failures = 0;
+
+void test_fail(const char* file, int line, const char* cond, const char* format, ...)
+{
+    if (test_failures++ >= TEST_MAX_REPORTS) return;
+
+    fprintf(stderr, "%s:%d: check failed: %s: ", file, line, cond);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+uint64_t test_rand()
+{
+    // xorshift64*
+    static uint64_t state = 0x9e3779b97f4a7c15ull;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+int main(int argc, char** argv)
+{
+    int failed = 0;
+
+    // With arguments only the tests whose name starts with one of them run
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool selected = argc == 1;
+        for (int j = 1; j < argc; j++) {
+            if (strncmp(tests[i].name, argv[j], strlen(argv[j])) == 0) selected = true;
+        }
+        if (!selected) continue;
+
+        test_failures = 0;
+        tests[i].run();
+        printf("%-20s %s", tests[i].name, test_failures == 0 ? "ok" : "FAILED");
+        if (test_failures > 0) printf(" (%zu checks)", test_failures);
+        printf("\n");
+        if (test_failures > 0) failed++;
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char* name;
+    void (*run)();
+} test;
+
+// Record a failure without stopping the test, so one run reports every
+// broken case. The message is printed only for failures.
+#define test_check(cond, ...) \
+    do { \
+        if (!(cond)) test_fail(__FILE__, __LINE__, #cond, __VA_ARGS__); \
+    } while (0)
+
+void test_fail(const char* file, int line, const char* cond, const char* format, ...);
+
+// Deterministic so failures reproduce
+uint64_t test_rand();
+
+void test_hash_table_typed();
+void test_string();
+void test_temp_alloc();
@@ -22,11 +22,27 @@ int main(int argc, char** argv)
 {
     int exit_code = EXIT_SUCCESS;
 
-    if (argc < 2) {
-        fprintf(stderr, "usage: %s file\n", argv[0]);
+    const char* file_path = NULL;
+    bool mem_stats = false;
+    bool hugepages = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = true;
+        } else if (strcmp(argv[i], "--hugepages") == 0) {
+            hugepages = true;
+        } else {
+            file_path = argv[i];
+        }
+    }
+
+    if (file_path == NULL) {
+        fprintf(stderr, "usage: %s [--mem-stats] [--hugepages] file\n", argv[0]);
         return EXIT_FAILURE;
     }
-    const char* file_path = argv[1];
+
+    if (mem_stats) temp_stats_enable();
+    if (hugepages) temp_hugepages_enable();
 
     string_builder sb = sb_init(NULL);
     if (!sb_read_file(&sb, file_path)) return_defer(exit_code, EXIT_FAILURE);
@@ -44,10 +60,11 @@ int main(int argc, char** argv)
 
     struct Error* error = NULL;
 
-    Stmts* stmts = NULL;
-    da_init(stmts);
-
     temp_allocator allocator = temp_init();
+    temp_set_name(allocator, "parser");
+
+    Stmts* stmts = temp_alloc(allocator, sizeof(Stmts));
+    sda_init_with_allocator(stmts, temp_da_allocator(allocator));
 
     struct Parser parser;
 
@@ -62,7 +79,7 @@ int main(int argc, char** argv)
             free_stmt(stmts->items[i]);
         }
 
-        da_free(stmts);
+        sda_free(stmts);
         return_defer(exit_code, EXIT_FAILURE);
     }
 
@@ -76,7 +93,7 @@ int main(int argc, char** argv)
         print_error(error);
 
         interpreter_destroy(intp);
-        da_free(stmts);
+        sda_free(stmts);
         return_defer(exit_code, EXIT_FAILURE);
     }
 
@@ -86,9 +103,11 @@ int main(int argc, char** argv)
         free_stmt(stmts->items[i]);
     }
 
-    da_free(stmts);
+    sda_free(stmts);
 
 defer:
     sb_free(&sb);
+    if (mem_stats) temp_print_stats(stderr);
+    symbols_free();
     return exit_code;
 }
\ No newline at end of file
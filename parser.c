@@ -69,8 +69,8 @@ struct Error* parse_finish_call(struct Parser* parser, struct Expr** result)
 
     struct Expr *calle = *result;
 
-    Exprs* arguments = NULL;
-    da_init(arguments);
+    Exprs* arguments = temp_alloc(parser->allocator, sizeof(Exprs));
+    sda_init_with_allocator(arguments, temp_da_allocator(parser->allocator));
 
     if (!sv_equal_cstr(parser->token->lexeme, ")")) {
         do {
@@ -83,7 +83,7 @@ struct Error* parse_finish_call(struct Parser* parser, struct Expr** result)
                 trace(error);
             }
 
-            da_append(arguments, expression);
+            sda_append(arguments, expression);
 
             if (sv_equal_cstr(parser->token->lexeme, ",")) {
                 lex_get_token(parser->lexer, parser->token); // Consume ','
@@ -446,11 +446,11 @@ struct Error* parse_for_statement(struct Parser* parser, struct Stmt** result)
     }
 
     if (increment != NULL) {
-        Stmts *statements = NULL;
-        da_init(statements);
+        Stmts *statements = temp_alloc(parser->allocator, sizeof(Stmts));
+        sda_init_with_allocator(statements, temp_da_allocator(parser->allocator));
 
-        da_append(statements, body);
-        da_append(statements, create_expression_stmt(parser->allocator, increment));
+        sda_append(statements, body);
+        sda_append(statements, create_expression_stmt(parser->allocator, increment));
 
         body = create_block_stmt(parser->allocator, statements);
     }
@@ -464,11 +464,11 @@ struct Error* parse_for_statement(struct Parser* parser, struct Stmt** result)
     body = create_while_stmt(parser->allocator, condition, body);
 
     if (initializer != NULL) {
-        Stmts *statements = NULL;
-        da_init(statements);
+        Stmts *statements = temp_alloc(parser->allocator, sizeof(Stmts));
+        sda_init_with_allocator(statements, temp_da_allocator(parser->allocator));
 
-        da_append(statements, initializer);
-        da_append(statements, body);
+        sda_append(statements, initializer);
+        sda_append(statements, body);
 
         body = create_block_stmt(parser->allocator, statements);
     }
@@ -522,23 +522,23 @@ struct Error* parse_function_statement(struct Parser* parser, struct Stmt** resu
         return trace(error);
     }
 
-    LexerTokens* parameters = NULL;
-    da_init(parameters);
+    LexerTokens* parameters = temp_alloc(parser->allocator, sizeof(LexerTokens));
+    sda_init_with_allocator(parameters, temp_da_allocator(parser->allocator));
 
     if (!sv_equal_cstr(parser->token->lexeme, ")")) {
         do {
             if (parameters->count >= 255) {
-                da_free(parameters);
+                sda_free(parameters);
                 return error("Can't have more than 255 parameters.");
             }
 
             if (parser->token->id != LEXER_SYMBOL) {
-                da_free(parameters);
+                sda_free(parameters);
                 return error("Expected parameter name.");
             }
 
             lexer_token param = *parser->token;
-            da_append(parameters, param);
+            sda_append(parameters, param);
 
             lex_get_token(parser->lexer, parser->token); // Consume 'identifier'
 
@@ -556,7 +556,7 @@ struct Error* parse_function_statement(struct Parser* parser, struct Stmt** resu
 
     Stmts* body = NULL;
     if (has_error(parse_block(parser, &body))) {
-        da_free(parameters);
+        sda_free(parameters);
         return trace(error);
     }
 
@@ -593,8 +593,8 @@ struct Error* parse_block(struct Parser* parser, Stmts** result)
 
     lex_get_token(parser->lexer, parser->token); // Consume '{'
     
-    Stmts* statements = NULL;
-    da_init(statements);
+    Stmts* statements = temp_alloc(parser->allocator, sizeof(Stmts));
+    sda_init_with_allocator(statements, temp_da_allocator(parser->allocator));
 
     while (!sv_equal_cstr(parser->token->lexeme, "}") && parser->token->id != LEXER_END) {
         struct Stmt* statement = NULL;
@@ -602,7 +602,7 @@ struct Error* parse_block(struct Parser* parser, Stmts** result)
             return trace(error);
         }
 
-        da_append(statements, statement);
+        sda_append(statements, statement);
     }
 
     lex_get_token(parser->lexer, parser->token); // Consume '}'
@@ -682,7 +682,7 @@ struct Error* parse(struct Parser* parser, Stmts* result)
         if (has_error(parse_declaration(parser, &stmt))) {
             return trace(error);
         }
-        da_append(result, stmt);
+        sda_append(result, stmt);
     }
 
     return NULL;
@@ -77,7 +77,7 @@ void free_stmt(struct Stmt* stmt)
         free_expr(stmt->variable.initializer);
         break;
     case STMT_BLOCK:
-        da_free(stmt->block.statements);
+        sda_free(stmt->block.statements);
         break;
     case STMT_IF:
         free_expr(stmt->if_stmt.condition);
@@ -89,8 +89,8 @@ void free_stmt(struct Stmt* stmt)
         free_stmt(stmt->while_stmt.body);
         break;
     case STMT_FUNCTION:
-        da_free(stmt->function_stmt.params);
-        da_free(stmt->function_stmt.body);
+        sda_free(stmt->function_stmt.params);
+        sda_free(stmt->function_stmt.body);
         break;
     case STMT_RETURN:
         free_expr(stmt->return_stmt.value);
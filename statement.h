@@ -2,11 +2,7 @@
 
 #include "expression.h"
 
-typedef struct {
-    size_t count;
-    size_t capacity;
-    struct Stmt** items;
-} Stmts;
+typedef da_small(struct Stmt*, 4) Stmts;
 
 typedef enum {
     STMT_EXPRESSION,
@@ -13,8 +13,14 @@ int main(int argc, char** argv)
     builder_add_source_file(&builder, "debug.c");
     builder_add_source_file(&builder, "value.c");
     builder_add_source_file(&builder, "compiler.c");
+    builder_add_source_file(&builder, "peephole.c");
     builder_add_source_file(&builder, "scanner.c");
+    builder_add_source_file(&builder, "globals.c");
+    builder_add_source_file(&builder, "memory.c");
     builder_add_source_file(&builder, "../libs/string.c");
+    builder_add_source_file(&builder, "../libs/temp_alloc.c");
+    builder_add_source_file(&builder, "../libs/hash_table.c");
+    builder_add_source_file(&builder, "../libs/symbol.c");
 
     builder_build(&builder);
 
@@ -1,31 +1,144 @@
+#include "memory.h"
+#define DA_MALLOC(size) reallocate(NULL, size)
+#define DA_REALLOC reallocate
+#define DA_FREE release
 #include "../libs/dynamic_array.h"
 #include "value.h"
 
 #include "chunk.h"
 
+const uint8_t opcode_operands[UINT8_MAX + 1] = {
+#ifdef VM_REGISTER
+    [OP_CONSTANT]      = 2,
+    [OP_CONSTANT_LONG] = 4,
+    [OP_EQUAL]         = 3,
+    [OP_GREATER]       = 3,
+    [OP_LESS]          = 3,
+    [OP_ADD]           = 3,
+    [OP_SUBTRACT]      = 3,
+    [OP_MULTIPLY]      = 3,
+    [OP_DIVIDE]        = 3,
+    [OP_NOT]           = 2,
+    [OP_NEGATE]        = 2,
+    [OP_GET_GLOBAL]    = 3,
+    [OP_DEFINE_GLOBAL] = 3,
+    [OP_SET_GLOBAL]    = 3,
+    [OP_PRINT]         = 1,
+    [OP_NOT_EQUAL]     = 3,
+    [OP_GREATER_EQUAL] = 3,
+    [OP_LESS_EQUAL]    = 3,
+#else
+    [OP_CONSTANT]       = 1,
+    [OP_CONSTANT_LONG]  = 3,
+    [OP_GET_GLOBAL]     = 2,
+    [OP_DEFINE_GLOBAL]  = 2,
+    [OP_SET_GLOBAL]     = 2,
+    [OP_ADD_CONST]      = 1,
+    [OP_SUBTRACT_CONST] = 1,
+    [OP_MULTIPLY_CONST] = 1,
+    [OP_CHECK_GLOBAL]   = 2,
+#endif
+};
+
 void init_chunk(Chunk* chunk)
 {
     da_init(chunk);
-    chunk->lines = NULL;
+    init_line_table(&chunk->lines);
     init_value_array(&chunk->constants);
+    constant_index_init(&chunk->constant_index);
+    chunk->max_stack = 0;
+}
+
+void init_line_table(LineTable* lines)
+{
+    da_init(lines);
+}
+
+void add_line(LineTable* lines, int offset, int line)
+{
+    if (lines->count > 0 && lines->items[lines->count - 1].line == line) return;
+    da_append(lines, ((LineRun){ .offset = offset, .line = line }));
+}
+
+void free_line_table(LineTable* lines)
+{
+    da_free(lines);
 }
 
 void write_chunk(Chunk* chunk, uint8_t byte, int line)
 {
+    add_line(&chunk->lines, chunk->count, line);
     da_append(chunk, byte);
-    da_grow(chunk->lines, chunk->count, chunk->capacity);
-    chunk->lines[chunk->count - 1] = line;
+}
+
+void truncate_chunk(Chunk* chunk, int count)
+{
+    chunk->count = count;
+    LineTable* lines = &chunk->lines;
+    while (lines->count > 0 && lines->items[lines->count - 1].offset >= count) {
+        lines->count--;
+    }
+}
+
+int get_line(Chunk* chunk, int offset)
+{
+    // Last run starting at or before offset
+    LineRun* runs = chunk->lines.items;
+    int low = 0;
+    int high = chunk->lines.count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (runs[mid].offset <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return runs[low].line;
+}
+
+// The NaN-boxed word of the value. Without NaN boxing numbers give their
+// double bits and nil and booleans the quiet NaNs NaN boxing tags them with,
+// which arithmetic never produces.
+static uint64_t constant_key(Value value)
+{
+#ifdef NAN_BOXING
+    return value;
+#else
+    if (IS_NUMBER(value)) {
+        uint64_t bits;
+        memcpy(&bits, &value.as.number, sizeof(double));
+        return bits;
+    }
+    uint64_t tag = IS_NIL(value) ? 1 : AS_BOOL(value) ? 3 : 2;
+    return 0x7ffc000000000000ull | tag;
+#endif
 }
 
 int add_constant(Chunk* chunk, Value value)
 {
-    write_value_array(&chunk->constants, value);
-    return chunk->constants.count - 1;
+    bool inserted;
+    int* index = constant_index_get_or_insert(&chunk->constant_index, constant_key(value), &inserted);
+    if (inserted) {
+        *index = chunk->constants.count;
+        write_value_array(&chunk->constants, value);
+    }
+    return *index;
+}
+
+void truncate_constants(Chunk* chunk, int count)
+{
+    ValueArray* constants = &chunk->constants;
+    while (constants->count > count) {
+        constants->count--;
+        constant_index_delete(&chunk->constant_index, constant_key(constants->items[constants->count]));
+    }
 }
 
 void free_chunk(Chunk* chunk)
 {
-    free(chunk->lines);
+    free_line_table(&chunk->lines);
+    constant_index_free(&chunk->constant_index);
     free_value_array(&chunk->constants);
     da_free(chunk);
 }
@@ -1,13 +1,56 @@
 #pragma once
 
 #include "common.h"
+#include "memory.h"
 #include "value.h"
+#define HT_MALLOC(size) reallocate(NULL, size)
+#define HT_FREE release
+#include "../libs/hash_table_typed.h"
+
+#ifdef VM_REGISTER
+
+// Three-address code over a register file: A is the destination register,
+// B and C are RK operands, either a register or, with RK_CONSTANT set, an
+// index into the constant pool.
+#define RK_CONSTANT     0x80
+#define RK_MAX_REGISTER 0x7F
+#define RK_MAX_CONSTANT 0x7F
+
+typedef enum {
+    OP_CONSTANT,  // A K      R[A] = K[K], for constants past RK_MAX_CONSTANT
+    OP_CONSTANT_LONG, // A K K K  R[A] = K[K], 24-bit index low byte first
+    OP_EQUAL,     // A B C    R[A] = RK(B) == RK(C)
+    OP_GREATER,   // A B C    R[A] = RK(B) > RK(C)
+    OP_LESS,      // A B C    R[A] = RK(B) < RK(C)
+    OP_ADD,       // A B C    R[A] = RK(B) + RK(C)
+    OP_SUBTRACT,  // A B C    R[A] = RK(B) - RK(C)
+    OP_MULTIPLY,  // A B C    R[A] = RK(B) * RK(C)
+    OP_DIVIDE,    // A B C    R[A] = RK(B) / RK(C)
+    OP_NOT,       // A B      R[A] = !RK(B)
+    OP_NEGATE,    // A B      R[A] = -RK(B)
+    OP_GET_GLOBAL,    // A G G    R[A] = G[G], 16-bit slot low byte first
+    OP_DEFINE_GLOBAL, // B G G    G[G] = RK(B)
+    OP_SET_GLOBAL,    // B G G    G[G] = RK(B), G[G] must be defined
+    OP_PRINT,     // B        print RK(B)
+    OP_RETURN,    //          end of the script
+    // Superinstructions, only produced by the peephole pass
+    OP_NOT_EQUAL,     // A B C    R[A] = !(RK(B) == RK(C))
+    OP_GREATER_EQUAL, // A B C    R[A] = !(RK(B) < RK(C))
+    OP_LESS_EQUAL,    // A B C    R[A] = !(RK(B) > RK(C))
+} OpCode;
+
+#else
 
 typedef enum {
     OP_CONSTANT,
+    OP_CONSTANT_LONG, // 24-bit constant index, low byte first
     OP_NIL,
     OP_TRUE,
     OP_FALSE,
+    OP_POP,
+    OP_GET_GLOBAL,    // 16-bit global slot, low byte first
+    OP_DEFINE_GLOBAL, // 16-bit global slot
+    OP_SET_GLOBAL,    // 16-bit global slot
     OP_EQUAL,
     OP_GREATER,
     OP_LESS,
@@ -17,18 +60,68 @@ typedef enum {
     OP_DIVIDE,
     OP_NOT,
     OP_NEGATE,
+    OP_PRINT,
     OP_RETURN,
+    // Superinstructions, only produced by the peephole pass
+    OP_NOT_EQUAL,      // OP_EQUAL, OP_NOT
+    OP_GREATER_EQUAL,  // OP_LESS, OP_NOT
+    OP_LESS_EQUAL,     // OP_GREATER, OP_NOT
+    OP_ADD_CONST,      // OP_CONSTANT k, OP_ADD
+    OP_SUBTRACT_CONST, // OP_CONSTANT k, OP_SUBTRACT
+    OP_MULTIPLY_CONST, // OP_CONSTANT k, OP_MULTIPLY
+    OP_CHECK_GLOBAL,   // OP_GET_GLOBAL g, OP_POP
 } OpCode;
 
+#endif
+
+// Constants addressable by OP_CONSTANT_LONG
+#define MAX_CONSTANTS (1 << 24)
+
+// Pool index of every constant, keyed by the bits of its value, so every
+// value is stored once
+HT_DECLARE_U64(constant_index, int)
+
+// Line information is run-length encoded: every run starts at the first
+// byte compiled from a new line and covers the code up to the next run.
+typedef struct {
+    int offset;
+    int line;
+} LineRun;
+
+typedef struct {
+    int count;
+    int capacity;
+    LineRun* items;
+} LineTable;
+
 typedef struct {
     int count;
     int capacity;
     uint8_t* items;
-    int* lines;
+    LineTable lines;
     ValueArray constants;
+    constant_index constant_index;
+    // Stack slots (registers with VM_REGISTER) the code uses at most, the
+    // VM makes room for them once before running it
+    int max_stack;
 } Chunk;
 
+// Operand bytes following each opcode
+extern const uint8_t opcode_operands[UINT8_MAX + 1];
+
 void init_chunk(Chunk* chunk);
 void write_chunk(Chunk* chunk, uint8_t byte, int line);
+// Drops the code from `count` on along with its line information
+void truncate_chunk(Chunk* chunk, int count);
+// Source line of the byte at offset, a binary search over the runs
+int get_line(Chunk* chunk, int offset);
+// For passes that rewrite the code: lines must be added in offset order
+void init_line_table(LineTable* lines);
+void add_line(LineTable* lines, int offset, int line);
+void free_line_table(LineTable* lines);
+// Index of `value` in the pool, it is only appended when not already there.
+// Values are matched by their bits, 0 and -0 are different constants.
 int add_constant(Chunk* chunk, Value value);
+// Drops the constants from `count` on
+void truncate_constants(Chunk* chunk, int count);
 void free_chunk(Chunk* chunk);
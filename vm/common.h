@@ -8,3 +8,30 @@
 
 // #define DEBUG_PRINT_CODE
 // #define DEBUG_TRACE_EXECUTION
+
+// Represent values as NaN-boxed 64-bit words instead of tagged structs
+// #define NAN_BOXING
+
+// Compile to three-address register code instead of stack code
+// #define VM_REGISTER
+
+// Skip the peephole pass that fuses instruction pairs
+// #define VM_NO_PEEPHOLE
+
+// Dispatch with a switch even when the compiler supports computed goto
+// #define VM_SWITCH_DISPATCH
+// Translate the chunk into handler addresses before running it, so
+// dispatch skips the opcode table lookup (computed goto only)
+// #define VM_PREDECODE
+
+// Count how often each opcode runs right after another and print the
+// counts to stderr when the process exits, to pick superinstructions
+// #define VM_PAIR_STATS
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+    #define VM_COMPUTED_GOTO
+#endif
+
+#if defined(VM_PREDECODE) && !defined(VM_COMPUTED_GOTO)
+    #undef VM_PREDECODE
+#endif
@@ -1,10 +1,17 @@
+#include "memory.h"
+#define DA_MALLOC(size) reallocate(NULL, size)
+#define DA_REALLOC reallocate
+#define DA_FREE release
+#include "../libs/dynamic_array.h"
 #include "compiler.h"
+#include "peephole.h"
 #include "scanner.h"
+#include "../libs/symbol.h"
 #ifdef DEBUG_PRINT_CODE
 #include "debug.h"
 #endif
 
-static void binary(Compiler* compiler);
+static void binary(Compiler* compiler, bool can_assign);
 static ParseRule* get_rule(TokenType type);
 
 static void error_at(Parser* parser, Token* token, const char* message)
@@ -57,6 +64,18 @@ static void consume(Compiler* compiler, TokenType type, const char* message)
     error_at_current(&compiler->parser, message);
 }
 
+static bool check(Compiler* compiler, TokenType type)
+{
+    return compiler->parser.current.type == type;
+}
+
+static bool match(Compiler* compiler, TokenType type)
+{
+    if (!check(compiler, type)) return false;
+    advance(compiler);
+    return true;
+}
+
 static Chunk* current_chunk(Compiler* compiler)
 {
     return compiler->compiling_chunk;
@@ -67,26 +86,99 @@ static void emit_byte(Compiler* compiler, uint8_t byte)
     write_chunk(compiler->compiling_chunk, byte, compiler->parser.previous.line);
 }
 
+static int make_constant(Compiler* compiler, Value value)
+{
+    int constant = add_constant(current_chunk(compiler), value);
+    if (constant >= MAX_CONSTANTS) {
+        error(&compiler->parser, "Too many constants in one chunk.");
+        return 0;
+    }
+
+    return constant;
+}
+
+// Operand of OP_CONSTANT_LONG
+static void emit_long_index(Compiler* compiler, int constant)
+{
+    emit_byte(compiler, constant & 0xff);
+    emit_byte(compiler, (constant >> 8) & 0xff);
+    emit_byte(compiler, (constant >> 16) & 0xff);
+}
+
+static int global_slot(Compiler* compiler, Token* name)
+{
+    const symbol* symbol = symbol_intern(sv_from_parts(name->start, name->length));
+    int slot = resolve_global(compiler->globals, symbol);
+    if (slot < 0) {
+        error(&compiler->parser, "Too many global variables.");
+        return 0;
+    }
+
+    return slot;
+}
+
+static void emit_global_slot(Compiler* compiler, int slot)
+{
+    emit_byte(compiler, slot & 0xff);
+    emit_byte(compiler, (slot >> 8) & 0xff);
+}
+
+#ifdef VM_REGISTER
+
 static void emit_bytes(Compiler* compiler, uint8_t byte1, uint8_t byte2)
 {
     emit_byte(compiler, byte1);
     emit_byte(compiler, byte2);
 }
 
-static uint8_t make_constant(Compiler* compiler, Value value)
+static uint8_t alloc_register(Compiler* compiler)
 {
-    int constant = add_constant(current_chunk(compiler), value);
-    if (constant > UINT8_MAX) {
-        error(&compiler->parser, "Too many constants in one chunk.");
+    if (compiler->register_top > RK_MAX_REGISTER) {
+        error(&compiler->parser, "Expression too complex.");
         return 0;
     }
 
-    return (uint8_t)constant;
+    uint8_t reg = (uint8_t)compiler->register_top++;
+    if (compiler->register_top > current_chunk(compiler)->max_stack) {
+        current_chunk(compiler)->max_stack = compiler->register_top;
+    }
+    return reg;
+}
+
+// Operands are consumed in the reverse order they were produced, so only the
+// topmost temporary can be the one released
+static void free_operand(Compiler* compiler, uint8_t operand)
+{
+    if (!(operand & RK_CONSTANT) && operand == compiler->register_top - 1) {
+        compiler->register_top--;
+    }
+}
+
+// Makes a pool entry the current result, in place when it fits an RK operand
+static void emit_pool_operand(Compiler* compiler, int constant)
+{
+    if (constant <= RK_MAX_CONSTANT) {
+        compiler->result = RK_CONSTANT | constant;
+        return;
+    }
+
+    // Too far into the pool to fit an RK operand
+    uint8_t reg = alloc_register(compiler);
+    if (constant <= UINT8_MAX) {
+        emit_bytes(compiler, OP_CONSTANT, reg);
+        emit_byte(compiler, constant);
+    } else {
+        emit_bytes(compiler, OP_CONSTANT_LONG, reg);
+        emit_long_index(compiler, constant);
+    }
+    compiler->result = reg;
 }
 
+// nil, true and false have no instructions of their own here, they are pool
+// entries like numbers
 static void emit_constant(Compiler* compiler, Value value)
 {
-    emit_bytes(compiler, OP_CONSTANT, make_constant(compiler, value));
+    emit_pool_operand(compiler, make_constant(compiler, value));
 }
 
 static void emit_return(Compiler* compiler)
@@ -94,9 +186,229 @@ static void emit_return(Compiler* compiler)
     emit_byte(compiler, OP_RETURN);
 }
 
+static void emit_get_global(Compiler* compiler, int slot)
+{
+    uint8_t dst = alloc_register(compiler);
+    emit_bytes(compiler, OP_GET_GLOBAL, dst);
+    emit_global_slot(compiler, slot);
+    compiler->result = dst;
+}
+
+// The assigned value stays the result, assignment is an expression
+static void emit_set_global(Compiler* compiler, OpCode op, int slot)
+{
+    emit_bytes(compiler, op, compiler->result);
+    emit_global_slot(compiler, slot);
+}
+
+static void emit_print(Compiler* compiler)
+{
+    emit_bytes(compiler, OP_PRINT, compiler->result);
+}
+
+// Only globals outlive a statement, so every register is free again
+static void end_statement(Compiler* compiler)
+{
+    compiler->register_top = 0;
+}
+
+static bool constant_operand(Compiler* compiler, uint8_t operand, Value* value)
+{
+    if (!(operand & RK_CONSTANT)) return false;
+    *value = current_chunk(compiler)->constants.items[operand & RK_MAX_CONSTANT];
+    return true;
+}
+
+#else
+
+static void emit_op(Compiler* compiler, OpCode op)
+{
+    da_append(&compiler->instructions, current_chunk(compiler)->count);
+    emit_byte(compiler, op);
+}
+
+static void emit_constant(Compiler* compiler, Value value)
+{
+    int constant = make_constant(compiler, value);
+    if (constant <= UINT8_MAX) {
+        emit_op(compiler, OP_CONSTANT);
+        emit_byte(compiler, constant);
+    } else {
+        emit_op(compiler, OP_CONSTANT_LONG);
+        emit_long_index(compiler, constant);
+    }
+}
+
+static void emit_return(Compiler* compiler)
+{
+    emit_op(compiler, OP_RETURN);
+}
+
+static void emit_get_global(Compiler* compiler, int slot)
+{
+    emit_op(compiler, OP_GET_GLOBAL);
+    emit_global_slot(compiler, slot);
+}
+
+// OP_DEFINE_GLOBAL pops the value, OP_SET_GLOBAL leaves it as the value of
+// the assignment
+static void emit_set_global(Compiler* compiler, OpCode op, int slot)
+{
+    emit_op(compiler, op);
+    emit_global_slot(compiler, slot);
+}
+
+static void emit_print(Compiler* compiler)
+{
+    emit_op(compiler, OP_PRINT);
+}
+
+// Every statement leaves the stack as it found it
+static void end_statement(Compiler* compiler)
+{
+    (void)compiler;
+}
+
+static void emit_value(Compiler* compiler, Value value)
+{
+    if (IS_NIL(value)) {
+        emit_op(compiler, OP_NIL);
+    } else if (IS_BOOL(value)) {
+        emit_op(compiler, AS_BOOL(value) ? OP_TRUE : OP_FALSE);
+    } else {
+        emit_constant(compiler, value);
+    }
+}
+
+// Start of the instruction emitted `back` instructions ago, -1 if none
+static int emitted(Compiler* compiler, int back)
+{
+    int index = compiler->instructions.count - 1 - back;
+    return index >= 0 ? compiler->instructions.items[index] : -1;
+}
+
+// The value loaded by the instruction at offset, if it is a constant load
+static bool loaded_constant(Compiler* compiler, int offset, Value* value)
+{
+    if (offset < 0) return false;
+
+    Chunk* chunk = current_chunk(compiler);
+    switch (chunk->items[offset]) {
+        case OP_CONSTANT: *value = chunk->constants.items[chunk->items[offset + 1]]; return true;
+        case OP_CONSTANT_LONG: {
+            uint8_t* operand = &chunk->items[offset + 1];
+            *value = chunk->constants.items[operand[0] | operand[1] << 8 | operand[2] << 16];
+            return true;
+        }
+        case OP_NIL:      *value = NIL_VAL; return true;
+        case OP_TRUE:     *value = BOOL_VAL(true); return true;
+        case OP_FALSE:    *value = BOOL_VAL(false); return true;
+        default:          return false;
+    }
+}
+
+// Drops the operand code from offset on, the folded value replaces it
+static void discard_code(Compiler* compiler, int offset)
+{
+    truncate_chunk(current_chunk(compiler), offset);
+    while (emitted(compiler, 0) >= offset) {
+        compiler->instructions.count--;
+    }
+}
+
+#endif
+
+// Operators on constants are evaluated here instead of at runtime. Operand
+// types the runtime would reject are left alone so the error still happens.
+static bool fold_unary(TokenType operator_type, Value operand, Value* result)
+{
+    switch (operator_type) {
+        case TOKEN_BANG:
+            *result = BOOL_VAL(IS_NIL(operand) || (IS_BOOL(operand) && !AS_BOOL(operand)));
+            return true;
+        case TOKEN_MINUS:
+            if (!IS_NUMBER(operand)) return false;
+            *result = NUMBER_VAL(-AS_NUMBER(operand));
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool fold_binary(TokenType operator_type, Value left, Value right, Value* result)
+{
+    switch (operator_type) {
+        case TOKEN_EQUAL_EQUAL: *result = BOOL_VAL(values_equal(left, right)); return true;
+        case TOKEN_BANG_EQUAL:  *result = BOOL_VAL(!values_equal(left, right)); return true;
+        default: break;
+    }
+
+    if (!IS_NUMBER(left) || !IS_NUMBER(right)) return false;
+    double a = AS_NUMBER(left);
+    double b = AS_NUMBER(right);
+
+    // Same expressions the VM evaluates, so NaN compares the same way
+    switch (operator_type) {
+        case TOKEN_GREATER:       *result = BOOL_VAL(a > b); return true;
+        case TOKEN_GREATER_EQUAL: *result = BOOL_VAL(!(a < b)); return true;
+        case TOKEN_LESS:          *result = BOOL_VAL(a < b); return true;
+        case TOKEN_LESS_EQUAL:    *result = BOOL_VAL(!(a > b)); return true;
+        case TOKEN_PLUS:          *result = NUMBER_VAL(a + b); return true;
+        case TOKEN_MINUS:         *result = NUMBER_VAL(a - b); return true;
+        case TOKEN_STAR:          *result = NUMBER_VAL(a * b); return true;
+        case TOKEN_SLASH:         *result = NUMBER_VAL(a / b); return true;
+        default:                  return false;
+    }
+}
+
+#ifndef VM_REGISTER
+
+// Values each instruction leaves on the stack minus the ones it takes
+static const int8_t stack_effect[UINT8_MAX + 1] = {
+    [OP_CONSTANT]       = 1,
+    [OP_CONSTANT_LONG]  = 1,
+    [OP_NIL]            = 1,
+    [OP_TRUE]           = 1,
+    [OP_FALSE]          = 1,
+    [OP_POP]            = -1,
+    [OP_GET_GLOBAL]     = 1,
+    [OP_DEFINE_GLOBAL]  = -1,
+    [OP_EQUAL]          = -1,
+    [OP_GREATER]        = -1,
+    [OP_LESS]           = -1,
+    [OP_ADD]            = -1,
+    [OP_SUBTRACT]       = -1,
+    [OP_MULTIPLY]       = -1,
+    [OP_DIVIDE]         = -1,
+    [OP_PRINT]          = -1,
+    [OP_NOT_EQUAL]      = -1,
+    [OP_GREATER_EQUAL]  = -1,
+    [OP_LESS_EQUAL]     = -1,
+};
+
+// The chunk has no jumps, so one pass over the code follows every path
+static int max_stack_depth(Chunk* chunk)
+{
+    int depth = 0;
+    int max_depth = 0;
+    for (int offset = 0; offset < chunk->count; offset += 1 + opcode_operands[chunk->items[offset]]) {
+        depth += stack_effect[chunk->items[offset]];
+        if (depth > max_depth) max_depth = depth;
+    }
+    return max_depth;
+}
+
+#endif
+
 static void end_compiler(Compiler* compiler)
 {
     emit_return(compiler);
+#ifndef VM_NO_PEEPHOLE
+    optimize_chunk(current_chunk(compiler));
+#endif
+#ifndef VM_REGISTER
+    current_chunk(compiler)->max_stack = max_stack_depth(current_chunk(compiler));
+#endif
 #ifdef DEBUG_PRINT_CODE
     if (!compiler->parser.had_error) {
         disassemble_chunk(current_chunk(compiler), "code");
@@ -104,7 +416,7 @@ static void end_compiler(Compiler* compiler)
 #endif
 }
 
-static void number(Compiler* compiler)
+static void number(Compiler* compiler, bool can_assign)
 {
     double value = strtod(compiler->parser.previous.start, NULL);
     emit_constant(compiler, NUMBER_VAL(value));
@@ -120,12 +432,21 @@ static void parse_precedence(Compiler* compiler, Precedence precedence)
         return;
     }
 
-    prefix_rule(compiler);
+    // Only an operand parsed at assignment precedence can be a target, so
+    // `a + b = c` does not assign to b
+    bool can_assign = precedence <= PREC_ASSIGNMENT;
+    int pool_start = current_chunk(compiler)->constants.count;
+    prefix_rule(compiler, can_assign);
 
     while (precedence <= get_rule(compiler->parser.current.type)->precedence) {
         advance(compiler);
         ParseFn infix_rule = get_rule(compiler->parser.previous.type)->infix;
-        infix_rule(compiler);
+        compiler->pool_start = pool_start;
+        infix_rule(compiler, can_assign);
+    }
+
+    if (can_assign && match(compiler, TOKEN_EQUAL)) {
+        error(&compiler->parser, "Invalid assignment target.");
     }
 }
 
@@ -134,34 +455,169 @@ static void expression(Compiler* compiler)
     parse_precedence(compiler, PREC_ASSIGNMENT);
 }
 
-static void grouping(Compiler* compiler)
+static void grouping(Compiler* compiler, bool can_assign)
 {
     expression(compiler);
     consume(compiler, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
 }
 
-static void unary(Compiler* compiler)
+static void variable(Compiler* compiler, bool can_assign)
+{
+    int slot = global_slot(compiler, &compiler->parser.previous);
+
+    if (can_assign && match(compiler, TOKEN_EQUAL)) {
+        expression(compiler);
+        emit_set_global(compiler, OP_SET_GLOBAL, slot);
+    } else {
+        emit_get_global(compiler, slot);
+    }
+}
+
+static void var_declaration(Compiler* compiler)
+{
+    consume(compiler, TOKEN_IDENTIFIER, "Expect variable name.");
+    int slot = global_slot(compiler, &compiler->parser.previous);
+
+    if (match(compiler, TOKEN_EQUAL)) {
+        expression(compiler);
+    } else {
+#ifdef VM_REGISTER
+        emit_constant(compiler, NIL_VAL);
+#else
+        emit_op(compiler, OP_NIL);
+#endif
+    }
+    consume(compiler, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
+
+    emit_set_global(compiler, OP_DEFINE_GLOBAL, slot);
+}
+
+static void print_statement(Compiler* compiler)
+{
+    expression(compiler);
+    consume(compiler, TOKEN_SEMICOLON, "Expect ';' after value.");
+    emit_print(compiler);
+}
+
+static void expression_statement(Compiler* compiler)
+{
+    expression(compiler);
+    consume(compiler, TOKEN_SEMICOLON, "Expect ';' after expression.");
+#ifndef VM_REGISTER
+    emit_op(compiler, OP_POP);
+#endif
+}
+
+// After an error, skip ahead to a likely statement boundary so one mistake
+// does not cascade into more errors
+static void synchronize(Compiler* compiler)
+{
+    compiler->parser.panic_mode = false;
+
+    while (compiler->parser.current.type != TOKEN_EOF) {
+        if (compiler->parser.previous.type == TOKEN_SEMICOLON) return;
+        switch (compiler->parser.current.type) {
+            case TOKEN_CLASS:
+            case TOKEN_FUN:
+            case TOKEN_VAR:
+            case TOKEN_FOR:
+            case TOKEN_IF:
+            case TOKEN_WHILE:
+            case TOKEN_PRINT:
+            case TOKEN_RETURN:
+                return;
+            default:
+                ; // Do nothing.
+        }
+
+        advance(compiler);
+    }
+}
+
+static void statement(Compiler* compiler)
+{
+    if (match(compiler, TOKEN_PRINT)) {
+        print_statement(compiler);
+    } else {
+        expression_statement(compiler);
+    }
+}
+
+static void declaration(Compiler* compiler)
+{
+    if (match(compiler, TOKEN_VAR)) {
+        var_declaration(compiler);
+    } else {
+        statement(compiler);
+    }
+    end_statement(compiler);
+
+    if (compiler->parser.panic_mode) synchronize(compiler);
+}
+
+static void unary(Compiler* compiler, bool can_assign)
 {
     TokenType operator_type = compiler->parser.previous.type;
+    int pool_start = current_chunk(compiler)->constants.count;
 
     // Compile the operand.
     parse_precedence(compiler, PREC_UNARY);
 
+    Value constant, folded;
+#ifdef VM_REGISTER
+    if (constant_operand(compiler, compiler->result, &constant) &&
+        fold_unary(operator_type, constant, &folded)) {
+        truncate_constants(current_chunk(compiler), pool_start);
+        emit_constant(compiler, folded);
+        return;
+    }
+
+    uint8_t operand = compiler->result;
+    free_operand(compiler, operand);
+    uint8_t dst = alloc_register(compiler);
+
+    switch (operator_type) {
+        case TOKEN_BANG: emit_bytes(compiler, OP_NOT, dst); break;
+        case TOKEN_MINUS: emit_bytes(compiler, OP_NEGATE, dst); break;
+        default: return; // Unreachable.
+    }
+    emit_byte(compiler, operand);
+    compiler->result = dst;
+#else
+    int operand = emitted(compiler, 0);
+    if (loaded_constant(compiler, operand, &constant) &&
+        fold_unary(operator_type, constant, &folded)) {
+        discard_code(compiler, operand);
+        truncate_constants(current_chunk(compiler), pool_start);
+        emit_value(compiler, folded);
+        return;
+    }
+
     // Emit the operator instruction.
     switch (operator_type) {
-        case TOKEN_BANG: emit_byte(compiler, OP_NOT); break;
-        case TOKEN_MINUS: emit_byte(compiler, OP_NEGATE); break;
+        case TOKEN_BANG: emit_op(compiler, OP_NOT); break;
+        case TOKEN_MINUS: emit_op(compiler, OP_NEGATE); break;
         default: return; // Unreachable.
     }
+#endif
 }
 
-static void literal(Compiler* compiler) {
+static void literal(Compiler* compiler, bool can_assign) {
+#ifdef VM_REGISTER
     switch (compiler->parser.previous.type) {
-      case TOKEN_FALSE: emit_byte(compiler, OP_FALSE); break;
-      case TOKEN_NIL: emit_byte(compiler, OP_NIL); break;
-      case TOKEN_TRUE: emit_byte(compiler, OP_TRUE); break;
+      case TOKEN_FALSE: emit_constant(compiler, BOOL_VAL(false)); break;
+      case TOKEN_NIL: emit_constant(compiler, NIL_VAL); break;
+      case TOKEN_TRUE: emit_constant(compiler, BOOL_VAL(true)); break;
       default: return; // Unreachable.
     }
+#else
+    switch (compiler->parser.previous.type) {
+      case TOKEN_FALSE: emit_op(compiler, OP_FALSE); break;
+      case TOKEN_NIL: emit_op(compiler, OP_NIL); break;
+      case TOKEN_TRUE: emit_op(compiler, OP_TRUE); break;
+      default: return; // Unreachable.
+    }
+#endif
 }
 
 ParseRule rules[] = {
@@ -184,7 +640,7 @@ ParseRule rules[] = {
     [TOKEN_GREATER_EQUAL] = { NULL,     binary, PREC_COMPARISON },
     [TOKEN_LESS]          = { NULL,     binary, PREC_COMPARISON },
     [TOKEN_LESS_EQUAL]    = { NULL,     binary, PREC_COMPARISON },
-    [TOKEN_IDENTIFIER]    = { NULL,     NULL,   PREC_NONE },
+    [TOKEN_IDENTIFIER]    = { variable, NULL,   PREC_NONE },
     [TOKEN_STRING]        = { NULL,     NULL,   PREC_NONE },
     [TOKEN_NUMBER]        = { number,   NULL,   PREC_NONE },
     [TOKEN_AND]           = { NULL,     NULL,   PREC_NONE },
@@ -212,43 +668,129 @@ static ParseRule* get_rule(TokenType type)
     return &rules[type];
 }
 
-static void binary(Compiler* compiler)
+#ifdef VM_REGISTER
+
+static void emit_three(Compiler* compiler, OpCode op, uint8_t dst, uint8_t left, uint8_t right)
+{
+    emit_bytes(compiler, op, dst);
+    emit_bytes(compiler, left, right);
+}
+
+static void binary(Compiler* compiler, bool can_assign)
+{
+    // Remember the operator and where the left operand ended up.
+    TokenType operator_type = compiler->parser.previous.type;
+    uint8_t left = compiler->result;
+    int pool_start = compiler->pool_start;
+
+    // Compile the right operand.
+    ParseRule* rule = get_rule(operator_type);
+    parse_precedence(compiler, (Precedence)(rule->precedence + 1));
+    uint8_t right = compiler->result;
+
+    Value a, b, folded;
+    if (constant_operand(compiler, left, &a) && constant_operand(compiler, right, &b) &&
+        fold_binary(operator_type, a, b, &folded)) {
+        truncate_constants(current_chunk(compiler), pool_start);
+        emit_constant(compiler, folded);
+        return;
+    }
+
+    free_operand(compiler, right);
+    free_operand(compiler, left);
+    uint8_t dst = alloc_register(compiler);
+    compiler->result = dst;
+
+    switch (operator_type) {
+        case TOKEN_BANG_EQUAL:
+            emit_three(compiler, OP_EQUAL, dst, left, right);
+            emit_bytes(compiler, OP_NOT, dst);
+            emit_byte(compiler, dst);
+            break;
+        case TOKEN_EQUAL_EQUAL:   emit_three(compiler, OP_EQUAL, dst, left, right); break;
+        case TOKEN_GREATER:       emit_three(compiler, OP_GREATER, dst, left, right); break;
+        case TOKEN_GREATER_EQUAL:
+            emit_three(compiler, OP_LESS, dst, left, right);
+            emit_bytes(compiler, OP_NOT, dst);
+            emit_byte(compiler, dst);
+            break;
+        case TOKEN_LESS:          emit_three(compiler, OP_LESS, dst, left, right); break;
+        case TOKEN_LESS_EQUAL:
+            emit_three(compiler, OP_GREATER, dst, left, right);
+            emit_bytes(compiler, OP_NOT, dst);
+            emit_byte(compiler, dst);
+            break;
+        case TOKEN_PLUS:  emit_three(compiler, OP_ADD, dst, left, right); break;
+        case TOKEN_MINUS: emit_three(compiler, OP_SUBTRACT, dst, left, right); break;
+        case TOKEN_STAR:  emit_three(compiler, OP_MULTIPLY, dst, left, right); break;
+        case TOKEN_SLASH: emit_three(compiler, OP_DIVIDE, dst, left, right); break;
+        default: return; // Unreachable.
+    }
+}
+
+#else
+
+static void binary(Compiler* compiler, bool can_assign)
 {
     // Remember the operator.
     TokenType operator_type = compiler->parser.previous.type;
+    int pool_start = compiler->pool_start;
 
     // Compile the right operand.
     ParseRule* rule = get_rule(operator_type);
     parse_precedence(compiler, (Precedence)(rule->precedence + 1));
 
+    // An expression only ends in a constant load when it is one, so the
+    // last two instructions being loads means both operands are constants
+    int left = emitted(compiler, 1);
+    Value a, b, folded;
+    if (loaded_constant(compiler, left, &a) &&
+        loaded_constant(compiler, emitted(compiler, 0), &b) &&
+        fold_binary(operator_type, a, b, &folded)) {
+        discard_code(compiler, left);
+        truncate_constants(current_chunk(compiler), pool_start);
+        emit_value(compiler, folded);
+        return;
+    }
+
     // Emit the operator instruction.
     switch (operator_type) {
-        case TOKEN_BANG_EQUAL:    emit_bytes(compiler, OP_EQUAL, OP_NOT); break;
-        case TOKEN_EQUAL_EQUAL:   emit_byte(compiler, OP_EQUAL); break;
-        case TOKEN_GREATER:       emit_byte(compiler, OP_GREATER); break;
-        case TOKEN_GREATER_EQUAL: emit_bytes(compiler, OP_LESS, OP_NOT); break;
-        case TOKEN_LESS:          emit_byte(compiler, OP_LESS); break;
-        case TOKEN_LESS_EQUAL:    emit_bytes(compiler, OP_GREATER, OP_NOT); break;
-        case TOKEN_PLUS: emit_byte(compiler, OP_ADD); break;
-        case TOKEN_MINUS: emit_byte(compiler, OP_SUBTRACT); break;
-        case TOKEN_STAR: emit_byte(compiler, OP_MULTIPLY); break;
-        case TOKEN_SLASH: emit_byte(compiler, OP_DIVIDE); break;
+        case TOKEN_BANG_EQUAL:    emit_op(compiler, OP_EQUAL); emit_op(compiler, OP_NOT); break;
+        case TOKEN_EQUAL_EQUAL:   emit_op(compiler, OP_EQUAL); break;
+        case TOKEN_GREATER:       emit_op(compiler, OP_GREATER); break;
+        case TOKEN_GREATER_EQUAL: emit_op(compiler, OP_LESS); emit_op(compiler, OP_NOT); break;
+        case TOKEN_LESS:          emit_op(compiler, OP_LESS); break;
+        case TOKEN_LESS_EQUAL:    emit_op(compiler, OP_GREATER); emit_op(compiler, OP_NOT); break;
+        case TOKEN_PLUS: emit_op(compiler, OP_ADD); break;
+        case TOKEN_MINUS: emit_op(compiler, OP_SUBTRACT); break;
+        case TOKEN_STAR: emit_op(compiler, OP_MULTIPLY); break;
+        case TOKEN_SLASH: emit_op(compiler, OP_DIVIDE); break;
         default: return; // Unreachable.
     }
 }
 
-bool compile(const char* source, Chunk* chunk)
+#endif
+
+bool compile(const char* source, Chunk* chunk, Globals* globals)
 { 
-    Compiler compiler;
+    Compiler compiler = {0};
     compiler.parser = (Parser){0};
     compiler.scanner = init_scanner(source);
     compiler.compiling_chunk = chunk;
+    compiler.globals = globals;
+#ifndef VM_REGISTER
+    da_init(&compiler.instructions);
+#endif
 
     advance(&compiler);
-    expression(&compiler);
-    consume(&compiler, TOKEN_EOF, "Expect end of expression.");
+    while (!match(&compiler, TOKEN_EOF)) {
+        declaration(&compiler);
+    }
 
     end_compiler(&compiler);
+#ifndef VM_REGISTER
+    da_free(&compiler.instructions);
+#endif
 
     return !compiler.parser.had_error;
 }
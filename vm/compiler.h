@@ -1,6 +1,7 @@
 #pragma once
 
 #include "chunk.h"
+#include "globals.h"
 #include "scanner.h"
 
 typedef enum {
@@ -28,9 +29,30 @@ typedef struct {
     Parser parser;
     Scanner scanner;
     Chunk* compiling_chunk;
+    Globals* globals;
+    // Size of the constant pool before the left operand of the operator
+    // being compiled, entries past it are dropped when the operator is folded
+    int pool_start;
+#ifdef VM_REGISTER
+    // RK operand holding the value of the expression compiled last
+    uint8_t result;
+    // Temporaries are allocated and freed like a stack, this is the next free one.
+    // Nothing is spilled: an expression with more than RK_MAX_REGISTER + 1 live
+    // temporaries, such as operands nested 128 levels deep on the right,
+    // fails with "Expression too complex." where the stack VM compiles it.
+    int register_top;
+#else
+    // Start offsets of the instructions emitted so far. An operator whose
+    // last two instructions are constant loads can be folded.
+    struct {
+        int* items;
+        int count;
+        int capacity;
+    } instructions;
+#endif
 } Compiler;
 
-typedef void (*ParseFn)(Compiler* compiler);
+typedef void (*ParseFn)(Compiler* compiler, bool can_assign);
 
 typedef struct {
     ParseFn prefix;
@@ -38,4 +60,4 @@ typedef struct {
     Precedence precedence;
 } ParseRule;
 
-bool compile(const char* source, Chunk* chunk);
+bool compile(const char* source, Chunk* chunk, Globals* globals);
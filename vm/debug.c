@@ -12,41 +12,229 @@ void disassemble_chunk(Chunk* chunk, const char* name)
     }
 }
 
+static int read_long_index(Chunk* chunk, int offset)
+{
+    uint8_t* operand = &chunk->items[offset];
+    return operand[0] | operand[1] << 8 | operand[2] << 16;
+}
+
+static int read_global_slot(Chunk* chunk, int offset)
+{
+    uint8_t* operand = &chunk->items[offset];
+    return operand[0] | operand[1] << 8;
+}
+
+static const char* const opcode_names[UINT8_MAX + 1] = {
+    [OP_CONSTANT]       = "OP_CONSTANT",
+    [OP_CONSTANT_LONG]  = "OP_CONSTANT_LONG",
+#ifndef VM_REGISTER
+    [OP_NIL]            = "OP_NIL",
+    [OP_TRUE]           = "OP_TRUE",
+    [OP_FALSE]          = "OP_FALSE",
+    [OP_POP]            = "OP_POP",
+#endif
+    [OP_GET_GLOBAL]     = "OP_GET_GLOBAL",
+    [OP_DEFINE_GLOBAL]  = "OP_DEFINE_GLOBAL",
+    [OP_SET_GLOBAL]     = "OP_SET_GLOBAL",
+    [OP_EQUAL]          = "OP_EQUAL",
+    [OP_GREATER]        = "OP_GREATER",
+    [OP_LESS]           = "OP_LESS",
+    [OP_ADD]            = "OP_ADD",
+    [OP_SUBTRACT]       = "OP_SUBTRACT",
+    [OP_MULTIPLY]       = "OP_MULTIPLY",
+    [OP_DIVIDE]         = "OP_DIVIDE",
+    [OP_NOT]            = "OP_NOT",
+    [OP_NEGATE]         = "OP_NEGATE",
+    [OP_PRINT]          = "OP_PRINT",
+    [OP_RETURN]         = "OP_RETURN",
+    [OP_NOT_EQUAL]      = "OP_NOT_EQUAL",
+    [OP_GREATER_EQUAL]  = "OP_GREATER_EQUAL",
+    [OP_LESS_EQUAL]     = "OP_LESS_EQUAL",
+#ifndef VM_REGISTER
+    [OP_ADD_CONST]      = "OP_ADD_CONST",
+    [OP_SUBTRACT_CONST] = "OP_SUBTRACT_CONST",
+    [OP_MULTIPLY_CONST] = "OP_MULTIPLY_CONST",
+    [OP_CHECK_GLOBAL]   = "OP_CHECK_GLOBAL",
+#endif
+};
+
+const char* opcode_name(uint8_t instruction)
+{
+    return opcode_names[instruction] ? opcode_names[instruction] : "OP_UNKNOWN";
+}
+
 static int simple_instruction(const char* name, int offset) {
     printf("%s\n", name);
     return offset + 1;
 }
 
+#ifndef VM_REGISTER
+
 static int constant_instruction(const char* name, Chunk* chunk, int offset) {
     uint8_t constant = chunk->items[offset + 1];
-    printf("%-16s %4d '", name, constant);
+    printf("%-17s %4d '", name, constant);
     print_value(chunk->constants.items[constant]);
     printf("'\n");
     return offset + 2;
 }
 
+static int constant_long_instruction(const char* name, Chunk* chunk, int offset) {
+    int constant = read_long_index(chunk, offset + 1);
+    printf("%-17s %4d '", name, constant);
+    print_value(chunk->constants.items[constant]);
+    printf("'\n");
+    return offset + 4;
+}
+
+static int global_instruction(const char* name, Chunk* chunk, int offset) {
+    printf("%-17s %4d\n", name, read_global_slot(chunk, offset + 1));
+    return offset + 3;
+}
+
+#else
+
+static void print_operand(Chunk* chunk, uint8_t operand)
+{
+    if (operand & RK_CONSTANT) {
+        printf("k%d '", operand & RK_MAX_CONSTANT);
+        print_value(chunk->constants.items[operand & RK_MAX_CONSTANT]);
+        printf("'");
+    } else {
+        printf("r%d", operand);
+    }
+}
+
+static int register_instruction(const char* name, Chunk* chunk, int offset, int operands)
+{
+    printf("%-17s r%d", name, chunk->items[offset + 1]);
+    for (int i = 2; i <= operands; i++) {
+        printf(", ");
+        print_operand(chunk, chunk->items[offset + i]);
+    }
+    printf("\n");
+    return offset + 1 + operands;
+}
+
+static int load_instruction(const char* name, Chunk* chunk, int offset)
+{
+    uint8_t constant = chunk->items[offset + 2];
+    printf("%-17s r%d, %d '", name, chunk->items[offset + 1], constant);
+    print_value(chunk->constants.items[constant]);
+    printf("'\n");
+    return offset + 3;
+}
+
+static int load_long_instruction(const char* name, Chunk* chunk, int offset)
+{
+    int constant = read_long_index(chunk, offset + 2);
+    printf("%-17s r%d, %d '", name, chunk->items[offset + 1], constant);
+    print_value(chunk->constants.items[constant]);
+    printf("'\n");
+    return offset + 5;
+}
+
+static int operand_instruction(const char* name, Chunk* chunk, int offset)
+{
+    printf("%-17s ", name);
+    print_operand(chunk, chunk->items[offset + 1]);
+    printf("\n");
+    return offset + 2;
+}
+
+static int get_global_instruction(const char* name, Chunk* chunk, int offset)
+{
+    printf("%-17s r%d, g%d\n", name, chunk->items[offset + 1], read_global_slot(chunk, offset + 2));
+    return offset + 4;
+}
+
+static int set_global_instruction(const char* name, Chunk* chunk, int offset)
+{
+    printf("%-17s g%d, ", name, read_global_slot(chunk, offset + 2));
+    print_operand(chunk, chunk->items[offset + 1]);
+    printf("\n");
+    return offset + 4;
+}
+
+#endif
+
 int disassemble_instruction(Chunk* chunk, int offset)
 {
     printf("%04d ", offset);
 
-    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
+    int line = get_line(chunk, offset);
+    if (offset > 0 && line == get_line(chunk, offset - 1)) {
         printf("   | ");
     } else {
-        printf("%4d ", chunk->lines[offset]);
+        printf("%4d ", line);
     }
 
     uint8_t instruction = chunk->items[offset];
+#ifdef VM_REGISTER
+    switch (instruction) {
+    case OP_CONSTANT:
+        return load_instruction("OP_CONSTANT", chunk, offset);
+    case OP_CONSTANT_LONG:
+        return load_long_instruction("OP_CONSTANT_LONG", chunk, offset);
+    case OP_EQUAL:
+        return register_instruction("OP_EQUAL", chunk, offset, 3);
+    case OP_GREATER:
+        return register_instruction("OP_GREATER", chunk, offset, 3);
+    case OP_LESS:
+        return register_instruction("OP_LESS", chunk, offset, 3);
+    case OP_ADD:
+        return register_instruction("OP_ADD", chunk, offset, 3);
+    case OP_SUBTRACT:
+        return register_instruction("OP_SUBTRACT", chunk, offset, 3);
+    case OP_MULTIPLY:
+        return register_instruction("OP_MULTIPLY", chunk, offset, 3);
+    case OP_DIVIDE:
+        return register_instruction("OP_DIVIDE", chunk, offset, 3);
+    case OP_NOT:
+        return register_instruction("OP_NOT", chunk, offset, 2);
+    case OP_NEGATE:
+        return register_instruction("OP_NEGATE", chunk, offset, 2);
+    case OP_GET_GLOBAL:
+        return get_global_instruction("OP_GET_GLOBAL", chunk, offset);
+    case OP_DEFINE_GLOBAL:
+        return set_global_instruction("OP_DEFINE_GLOBAL", chunk, offset);
+    case OP_SET_GLOBAL:
+        return set_global_instruction("OP_SET_GLOBAL", chunk, offset);
+    case OP_PRINT:
+        return operand_instruction("OP_PRINT", chunk, offset);
+    case OP_RETURN:
+        return simple_instruction("OP_RETURN", offset);
+    case OP_NOT_EQUAL:
+        return register_instruction("OP_NOT_EQUAL", chunk, offset, 3);
+    case OP_GREATER_EQUAL:
+        return register_instruction("OP_GREATER_EQUAL", chunk, offset, 3);
+    case OP_LESS_EQUAL:
+        return register_instruction("OP_LESS_EQUAL", chunk, offset, 3);
+    default:
+        printf("Unknown opcode %d\n", instruction);
+        return offset + 1;
+    }
+#else
     switch (instruction) {
     case OP_RETURN:
         return simple_instruction("OP_RETURN", offset);
     case OP_CONSTANT:
         return constant_instruction("OP_CONSTANT", chunk, offset);
+    case OP_CONSTANT_LONG:
+        return constant_long_instruction("OP_CONSTANT_LONG", chunk, offset);
     case OP_NIL:
         return simple_instruction("OP_NIL", offset);
     case OP_TRUE:
         return simple_instruction("OP_TRUE", offset);
     case OP_FALSE:
         return simple_instruction("OP_FALSE", offset);
+    case OP_POP:
+        return simple_instruction("OP_POP", offset);
+    case OP_GET_GLOBAL:
+        return global_instruction("OP_GET_GLOBAL", chunk, offset);
+    case OP_DEFINE_GLOBAL:
+        return global_instruction("OP_DEFINE_GLOBAL", chunk, offset);
+    case OP_SET_GLOBAL:
+        return global_instruction("OP_SET_GLOBAL", chunk, offset);
     case OP_EQUAL:
         return simple_instruction("OP_EQUAL", offset);
     case OP_GREATER:
@@ -65,8 +253,25 @@ int disassemble_instruction(Chunk* chunk, int offset)
         return simple_instruction("OP_NOT", offset);
     case OP_NEGATE:
         return simple_instruction("OP_NEGATE", offset);
+    case OP_PRINT:
+        return simple_instruction("OP_PRINT", offset);
+    case OP_NOT_EQUAL:
+        return simple_instruction("OP_NOT_EQUAL", offset);
+    case OP_GREATER_EQUAL:
+        return simple_instruction("OP_GREATER_EQUAL", offset);
+    case OP_LESS_EQUAL:
+        return simple_instruction("OP_LESS_EQUAL", offset);
+    case OP_ADD_CONST:
+        return constant_instruction("OP_ADD_CONST", chunk, offset);
+    case OP_SUBTRACT_CONST:
+        return constant_instruction("OP_SUBTRACT_CONST", chunk, offset);
+    case OP_MULTIPLY_CONST:
+        return constant_instruction("OP_MULTIPLY_CONST", chunk, offset);
+    case OP_CHECK_GLOBAL:
+        return global_instruction("OP_CHECK_GLOBAL", chunk, offset);
     default:
         printf("Unknown opcode %d\n", instruction);
         return offset + 1;
     }
+#endif
 }
@@ -4,3 +4,4 @@
 
 void disassemble_chunk(Chunk* chunk, const char* name);
 int disassemble_instruction(Chunk* chunk, int offset);
+const char* opcode_name(uint8_t instruction);
@@ -0,0 +1,38 @@
+#include "memory.h"
+#define DA_MALLOC(size) reallocate(NULL, size)
+#define DA_REALLOC reallocate
+#define DA_FREE release
+#include "../libs/dynamic_array.h"
+
+#include "globals.h"
+
+void init_globals(Globals* globals)
+{
+    init_value_array(&globals->values);
+    da_init(&globals->names);
+    ht_map_init(&globals->slots, vm_heap(), sizeof(int));
+}
+
+void free_globals(Globals* globals)
+{
+    ht_map_free(&globals->slots);
+    da_free(&globals->names);
+    free_value_array(&globals->values);
+}
+
+int resolve_global(Globals* globals, const symbol* name)
+{
+    bool inserted;
+    int* slot = ht_map_get_or_insert(&globals->slots, name, &inserted);
+    if (!inserted) return *slot;
+
+    if (globals->values.count == MAX_GLOBALS) {
+        *slot = -1;
+        return -1;
+    }
+
+    *slot = globals->values.count;
+    write_value_array(&globals->values, UNDEFINED_VAL);
+    da_append(&globals->names, name);
+    return *slot;
+}
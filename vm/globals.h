@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common.h"
+#include "value.h"
+#include "../libs/hash_table.h"
+#include "../libs/symbol.h"
+
+// Global slots are addressed by 16-bit operands
+#define MAX_GLOBALS (UINT16_MAX + 1)
+
+// Global variables are resolved to slots when the code is compiled, at
+// runtime they are a flat array indexed by the slot. A slot holds
+// UNDEFINED_VAL until its `var` declaration runs. The names are only used
+// to resolve identifiers and for error messages. They outlive the chunk, so
+// the REPL keeps the globals of earlier lines.
+typedef struct {
+    ValueArray values;
+    struct {
+        const symbol** items;
+        int count;
+        int capacity;
+    } names;
+    ht_map slots;       // symbol -> int slot
+} Globals;
+
+void init_globals(Globals* globals);
+void free_globals(Globals* globals);
+// Slot of the global `name`, a new undefined one the first time it is seen.
+// Returns -1 when there are already MAX_GLOBALS globals.
+int resolve_global(Globals* globals, const symbol* name);
@@ -1,7 +1,10 @@
 #include "vm.h"
 #include "../libs/string.h"
+#include "../libs/symbol.h"
+#include "../libs/temp_alloc.h"
 
 #include <errno.h>
+#include <time.h>
 
 static void repl(VM* vm)
 {
@@ -18,7 +21,14 @@ static void repl(VM* vm)
     }
 }
 
-static void run_file(VM* vm, const char* path)
+static double now_ns()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static void run_file(VM* vm, const char* path, int runs)
 {
     string_builder source = sb_init(NULL);
     if (!sb_read_file(&source, path)) {
@@ -26,26 +36,60 @@ static void run_file(VM* vm, const char* path)
         exit(EXIT_FAILURE);
     }
 
-    InterpretResult result = interpret(vm, source.items);
+    InterpretResult result;
+    if (runs == 0) {
+        result = interpret(vm, source.items);
+    } else {
+        // The chunk is compiled once, the time is dominated by running it
+        double start = now_ns();
+        result = interpret_repeated(vm, source.items, runs);
+        fprintf(stderr, "%-24s %10.0f ns\n", path, (now_ns() - start) / runs);
+    }
     sb_free(&source);
 
     if (result == INTERPRET_COMPILE_ERROR) exit(65);
     if (result == INTERPRET_RUNTIME_ERROR) exit(70);
 }
 
+static void print_mem_stats()
+{
+    temp_print_stats(stderr);
+}
+
 int main(int argc, char** argv)
 {
+    const char* path = NULL;
+    int runs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mem-stats") == 0) {
+            temp_stats_enable();
+            atexit(print_mem_stats);
+        } else if (strcmp(argv[i], "--hugepages") == 0) {
+            temp_hugepages_enable();
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            runs = atoi(argv[++i]);
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: vm.out [--mem-stats] [--hugepages] [--bench runs] [path]\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+#ifdef VM_PAIR_STATS
+    atexit(print_pair_stats);
+#endif
+
     VM vm = init_vm();
 
-    if (argc == 1) {
+    if (path == NULL) {
         repl(&vm);
-    } else if (argc == 2) {
-        run_file(&vm, argv[1]);
     } else {
-        fprintf(stderr, "Usage: vm.out [path]\n");
-        exit(EXIT_FAILURE);
+        run_file(&vm, path, runs);
     }
 
     free_vm(&vm);
+    symbols_free();
     return 0;
 }
\ No newline at end of file
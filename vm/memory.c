@@ -0,0 +1,28 @@
+#include "memory.h"
+
+static _Thread_local temp_allocator heap = {0};
+
+temp_allocator vm_heap()
+{
+    if (heap.arena == NULL) {
+        heap = temp_init();
+        temp_set_name(heap, "vm_heap");
+    }
+    return heap;
+}
+
+void free_vm_heap()
+{
+    temp_uninit(heap);
+    heap = (temp_allocator){0};
+}
+
+void* reallocate(void* pointer, size_t new_size)
+{
+    return temp_realloc(vm_heap(), pointer, new_size);
+}
+
+void release(void* pointer)
+{
+    temp_free(pointer);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.h"
+#include "../libs/temp_alloc.h"
+
+// Everything the VM allocates (bytecode, line info, constants) comes from
+// one temp_allocator per thread, the "VM heap".
+temp_allocator vm_heap();
+void free_vm_heap();
+
+void* reallocate(void* pointer, size_t new_size);
+void release(void* pointer);
@@ -0,0 +1,126 @@
+#include "peephole.h"
+
+// The fused pairs were picked from opcode-pair counts (VM_PAIR_STATS) over
+// compiled expressions: comparisons followed by OP_NOT (how !=, >= and <= compile)
+// and constants feeding +, - and *. Expression statements end in OP_POP,
+// a value pushed only to be popped is not pushed at all. The chunk has no
+// jumps yet, so any adjacent pair can be rewritten without checking for
+// jump targets.
+
+static void copy_instruction(Chunk* chunk, LineTable* lines, int* write, int read, int length, int line)
+{
+    add_line(lines, *write, line);
+    for (int i = 0; i < length; i++) {
+        chunk->items[*write] = chunk->items[read + i];
+        *write += 1;
+    }
+}
+
+#ifdef VM_REGISTER
+
+// `OP_x A B C; OP_NOT A A` becomes `OP_NOT_x A B C`
+static int fuse(Chunk* chunk, int offset, int next)
+{
+    uint8_t* code = chunk->items;
+    if (code[next] != OP_NOT) return -1;
+    if (code[next + 1] != code[offset + 1] || code[next + 2] != code[offset + 1]) return -1;
+
+    switch (code[offset]) {
+    case OP_EQUAL:   return OP_NOT_EQUAL;
+    case OP_LESS:    return OP_GREATER_EQUAL;
+    case OP_GREATER: return OP_LESS_EQUAL;
+    default:         return -1;
+    }
+}
+
+// Register code has no OP_POP, expression statements leave nothing behind
+static bool drops(Chunk* chunk, int offset, int next)
+{
+    return false;
+}
+
+#else
+
+// Returns the superinstruction for the pair at offset and next, or -1.
+// The fused instruction keeps the operands of the first one.
+static int fuse(Chunk* chunk, int offset, int next)
+{
+    uint8_t* code = chunk->items;
+    switch (code[offset]) {
+    case OP_EQUAL:   return code[next] == OP_NOT ? OP_NOT_EQUAL : -1;
+    case OP_LESS:    return code[next] == OP_NOT ? OP_GREATER_EQUAL : -1;
+    case OP_GREATER: return code[next] == OP_NOT ? OP_LESS_EQUAL : -1;
+    // The value is dropped but reading an undefined global is still an error
+    case OP_GET_GLOBAL: return code[next] == OP_POP ? OP_CHECK_GLOBAL : -1;
+    case OP_CONSTANT:
+        switch (code[next]) {
+        case OP_ADD:      return OP_ADD_CONST;
+        case OP_SUBTRACT: return OP_SUBTRACT_CONST;
+        case OP_MULTIPLY: return OP_MULTIPLY_CONST;
+        default:          return -1;
+        }
+    default:
+        return -1;
+    }
+}
+
+// Whether the pair only pushes a value and pops it again, a literal or
+// constant used as a statement
+static bool drops(Chunk* chunk, int offset, int next)
+{
+    uint8_t* code = chunk->items;
+    if (code[next] != OP_POP) return false;
+    switch (code[offset]) {
+    case OP_CONSTANT:
+    case OP_CONSTANT_LONG:
+    case OP_NIL:
+    case OP_TRUE:
+    case OP_FALSE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif
+
+void optimize_chunk(Chunk* chunk)
+{
+    // Fused code is never longer, so it is written over the original
+    // Line runs are rebuilt as the code is written, the old ones are still
+    // read for the instructions that follow
+    int write = 0;
+    int read = 0;
+    LineTable lines;
+    init_line_table(&lines);
+
+    while (read < chunk->count) {
+        int length = 1 + opcode_operands[chunk->items[read]];
+        int next = read + length;
+
+        if (next < chunk->count) {
+            if (drops(chunk, read, next)) {
+                read = next + 1 + opcode_operands[chunk->items[next]];
+                continue;
+            }
+            int fused = fuse(chunk, read, next);
+            if (fused >= 0) {
+                // The second instruction is the one that can fail at runtime,
+                // errors report its line
+                int line = get_line(chunk, next);
+                int start = write;
+                copy_instruction(chunk, &lines, &write, read, length, line);
+                chunk->items[start] = (uint8_t)fused;
+                read = next + 1 + opcode_operands[chunk->items[next]];
+                continue;
+            }
+        }
+
+        copy_instruction(chunk, &lines, &write, read, length, get_line(chunk, read));
+        read = next;
+    }
+
+    chunk->count = write;
+    free_line_table(&chunk->lines);
+    chunk->lines = lines;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "chunk.h"
+
+// Rewrites the chunk in place, fusing common instruction pairs into
+// superinstructions and dropping values that are pushed only to be popped.
+// Line information follows the rewritten code.
+void optimize_chunk(Chunk* chunk);
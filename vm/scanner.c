@@ -72,6 +72,7 @@ static void skip_whitespace(Scanner* scanner)
             advance(scanner);
             break;
         case '\n':
+            scanner->line++;
             advance(scanner);
             break;
         case '/':
@@ -1,3 +1,7 @@
+#include "memory.h"
+#define DA_MALLOC(size) reallocate(NULL, size)
+#define DA_REALLOC reallocate
+#define DA_FREE release
 #include "../libs/dynamic_array.h"
 #include <stdio.h>
 
@@ -19,12 +23,12 @@ void free_value_array(ValueArray* array)
 }
 
 void print_value(Value value)
-{  
-    switch (value.type) {
-        case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
-            break;
-        case VAL_NIL: printf("nil"); break;
-        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+{
+    if (IS_BOOL(value)) {
+        printf(AS_BOOL(value) ? "true" : "false");
+    } else if (IS_NIL(value)) {
+        printf("nil");
+    } else if (IS_NUMBER(value)) {
+        printf("%g", AS_NUMBER(value));
     }
 }
@@ -1,11 +1,61 @@
 #pragma once
 
-#include <stdbool.h>
+#include "common.h"
+
+#include <string.h>
+
+#ifdef NAN_BOXING
+
+// A Value is a double, unless its bits are a quiet NaN. Those are never
+// produced by arithmetic, so the remaining payload bits encode the other
+// types: the low bits tag nil, false and true. The sign bit is left free
+// for boxing object pointers.
+typedef uint64_t Value;
+
+#define QNAN     ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NIL       1
+#define TAG_FALSE     2
+#define TAG_TRUE      3
+#define TAG_UNDEFINED 4
+
+#define FALSE_VAL         ((Value)(uint64_t)(QNAN | TAG_FALSE))
+#define TRUE_VAL          ((Value)(uint64_t)(QNAN | TAG_TRUE))
+
+#define IS_BOOL(value)    (((value) | 1) == TRUE_VAL)
+#define IS_NIL(value)     ((value) == NIL_VAL)
+#define IS_NUMBER(value)  (((value) & QNAN) != QNAN)
+#define IS_UNDEFINED(value) ((value) == UNDEFINED_VAL)
+
+#define AS_BOOL(value)    ((value) == TRUE_VAL)
+#define AS_NUMBER(value)  value_to_num(value)
+
+#define BOOL_VAL(b)       ((b) ? TRUE_VAL : FALSE_VAL)
+#define NIL_VAL           ((Value)(uint64_t)(QNAN | TAG_NIL))
+#define NUMBER_VAL(num)   num_to_value(num)
+#define UNDEFINED_VAL     ((Value)(uint64_t)(QNAN | TAG_UNDEFINED))
+
+static inline double value_to_num(Value value)
+{
+    double num;
+    memcpy(&num, &value, sizeof(Value));
+    return num;
+}
+
+static inline Value num_to_value(double num)
+{
+    Value value;
+    memcpy(&value, &num, sizeof(double));
+    return value;
+}
+
+#else
 
 typedef enum {
     VAL_BOOL,
     VAL_NIL, 
     VAL_NUMBER,
+    VAL_UNDEFINED,  // unassigned global slot, never seen by scripts
 } ValueType;
 
 typedef struct {
@@ -19,6 +69,7 @@ typedef struct {
 #define IS_BOOL(value)    ((value).type == VAL_BOOL)
 #define IS_NIL(value)     ((value).type == VAL_NIL)
 #define IS_NUMBER(value)  ((value).type == VAL_NUMBER)
+#define IS_UNDEFINED(value) ((value).type == VAL_UNDEFINED)
 
 #define AS_BOOL(value)    ((value).as.boolean)
 #define AS_NUMBER(value)  ((value).as.number)
@@ -26,6 +77,9 @@ typedef struct {
 #define BOOL_VAL(value)   ((Value){VAL_BOOL, {.boolean = value}})
 #define NIL_VAL           ((Value){VAL_NIL, {.number = 0}})
 #define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
+#define UNDEFINED_VAL     ((Value){VAL_UNDEFINED, {.number = 0}})
+
+#endif
 
 typedef struct {
     int capacity;
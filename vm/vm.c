@@ -2,8 +2,9 @@
 #include "chunk.h"
 #include "compiler.h"
 #include "value.h"
+#include "memory.h"
 #include <stdarg.h>
-#ifdef DEBUG_TRACE_EXECUTION
+#if defined(DEBUG_TRACE_EXECUTION) || defined(VM_PAIR_STATS)
 #include "debug.h"
 #endif
 
@@ -21,7 +22,7 @@ static void runtime_error(VM* vm, const char* format, ...)
     fputs("\n", stderr);
   
     size_t instruction = vm->ip - vm->chunk->items - 1;
-    int line = vm->chunk->lines[instruction];
+    int line = get_line(vm->chunk, instruction);
     fprintf(stderr, "[line %d] in script\n", line);
     reset_stack(vm);
 }
@@ -29,18 +30,40 @@ static void runtime_error(VM* vm, const char* format, ...)
 VM init_vm()
 {
     VM vm = {0};
+    init_globals(&vm.globals);
+    vm.stack_capacity = STACK_INITIAL;
+    vm.stack = reallocate(NULL, vm.stack_capacity * sizeof(Value));
     reset_stack(&vm);
     return vm;
 }
 
 void free_vm(VM* vm)
 {
+    release(vm->stack);
+    free_globals(&vm->globals);
+    free_vm_heap();
+}
+
+// Called with an empty stack before a chunk runs, so push and the register
+// accesses never need a bounds check. Big stacks are large blocks of the
+// VM heap and grow with mremap.
+static void reserve_stack(VM* vm, int slots)
+{
+    if (slots <= vm->stack_capacity) return;
+
+    while (vm->stack_capacity < slots) {
+        vm->stack_capacity *= 2;
+    }
+    vm->stack = reallocate(vm->stack, vm->stack_capacity * sizeof(Value));
+    reset_stack(vm);
 }
 
+#ifndef VM_REGISTER
 static Value peek(VM* vm, int distance)
 {
     return vm->stack_top[-1 - distance];
 }
+#endif
 
 static bool is_falsey(Value value)
 {
@@ -49,6 +72,11 @@ static bool is_falsey(Value value)
 
 bool values_equal(Value a, Value b)
 {
+#ifdef NAN_BOXING
+    // Numbers compare as doubles so NaN != NaN, everything else by identity
+    if (IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    return a == b;
+#else
     if (a.type != b.type) return false;
     switch (a.type) {
       case VAL_BOOL:   return AS_BOOL(a) == AS_BOOL(b);
@@ -56,91 +84,456 @@ bool values_equal(Value a, Value b)
       case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
       default:         return false; // Unreachable.
     }
+#endif
 }
 
+#ifdef VM_PREDECODE
+// Every byte of the chunk becomes one slot: opcodes are replaced by the
+// address of their handler and operands are kept as they are. Offsets stay
+// the same, so line lookup and tracing work unchanged.
+static void** predecode(Chunk* chunk, void* const* dispatch_table)
+{
+    void** code = reallocate(NULL, chunk->count * sizeof(void*));
+    for (int offset = 0; offset < chunk->count;) {
+        uint8_t instruction = chunk->items[offset];
+        code[offset++] = dispatch_table[instruction];
+        for (int i = 0; i < opcode_operands[instruction]; i++, offset++) {
+            code[offset] = (void*)(uintptr_t)chunk->items[offset];
+        }
+    }
+    return code;
+}
+#endif
+
+#ifdef VM_PAIR_STATS
+// Executions of each opcode right after another, over every chunk the
+// process runs
+static uint64_t pair_counts[UINT8_MAX + 1][UINT8_MAX + 1];
+
+typedef struct {
+    uint8_t first;
+    uint8_t second;
+    uint64_t count;
+} OpcodePair;
+
+static int compare_pairs(const void* a, const void* b)
+{
+    uint64_t count_a = ((const OpcodePair*)a)->count;
+    uint64_t count_b = ((const OpcodePair*)b)->count;
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+// Runs at exit after the VM heap is gone, so the pairs are sorted in a
+// static array
+void print_pair_stats()
+{
+    static OpcodePair pairs[(UINT8_MAX + 1) * (UINT8_MAX + 1)];
+    size_t count = 0;
+    for (int first = 0; first <= UINT8_MAX; first++) {
+        for (int second = 0; second <= UINT8_MAX; second++) {
+            if (pair_counts[first][second] == 0) continue;
+            pairs[count++] = (OpcodePair){first, second, pair_counts[first][second]};
+        }
+    }
+    qsort(pairs, count, sizeof(OpcodePair), compare_pairs);
+
+    fprintf(stderr, "== opcode pairs ==\n");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stderr, "%-18s %-18s %12llu\n", opcode_name(pairs[i].first),
+                opcode_name(pairs[i].second), (unsigned long long)pairs[i].count);
+    }
+}
+#endif
+
+// The handlers are written once against the macros below, which expand to
+// a switch inside a loop or, with GCC and Clang, to computed goto where
+// every handler jumps straight to the next one through dispatch_table.
 static InterpretResult run(VM* vm)
 {
-    #define READ_BYTE() (*vm->ip++)
+    InterpretResult result;
+
+#ifdef VM_COMPUTED_GOTO
+    static void* const dispatch_table[] = {
+        [OP_CONSTANT] = &&do_OP_CONSTANT,
+        [OP_CONSTANT_LONG] = &&do_OP_CONSTANT_LONG,
+#ifndef VM_REGISTER
+        [OP_NIL]      = &&do_OP_NIL,
+        [OP_TRUE]     = &&do_OP_TRUE,
+        [OP_FALSE]    = &&do_OP_FALSE,
+#endif
+        [OP_EQUAL]    = &&do_OP_EQUAL,
+        [OP_GREATER]  = &&do_OP_GREATER,
+        [OP_LESS]     = &&do_OP_LESS,
+        [OP_ADD]      = &&do_OP_ADD,
+        [OP_SUBTRACT] = &&do_OP_SUBTRACT,
+        [OP_MULTIPLY] = &&do_OP_MULTIPLY,
+        [OP_DIVIDE]   = &&do_OP_DIVIDE,
+        [OP_NOT]      = &&do_OP_NOT,
+        [OP_NEGATE]   = &&do_OP_NEGATE,
+#ifndef VM_REGISTER
+        [OP_POP]      = &&do_OP_POP,
+#endif
+        [OP_GET_GLOBAL]    = &&do_OP_GET_GLOBAL,
+        [OP_DEFINE_GLOBAL] = &&do_OP_DEFINE_GLOBAL,
+        [OP_SET_GLOBAL]    = &&do_OP_SET_GLOBAL,
+        [OP_PRINT]    = &&do_OP_PRINT,
+        [OP_RETURN]   = &&do_OP_RETURN,
+
+        [OP_NOT_EQUAL]     = &&do_OP_NOT_EQUAL,
+        [OP_GREATER_EQUAL] = &&do_OP_GREATER_EQUAL,
+        [OP_LESS_EQUAL]    = &&do_OP_LESS_EQUAL,
+#ifndef VM_REGISTER
+        [OP_ADD_CONST]      = &&do_OP_ADD_CONST,
+        [OP_SUBTRACT_CONST] = &&do_OP_SUBTRACT_CONST,
+        [OP_MULTIPLY_CONST] = &&do_OP_MULTIPLY_CONST,
+        [OP_CHECK_GLOBAL]   = &&do_OP_CHECK_GLOBAL,
+#endif
+    };
+#endif
+
+#ifdef VM_PREDECODE
+    void** code = predecode(vm->chunk, dispatch_table);
+    void** ip = code + (vm->ip - vm->chunk->items);
+    #define READ_BYTE() ((uint8_t)(uintptr_t)*ip++)
+    #define SYNC_IP() (vm->ip = vm->chunk->items + (ip - code))
+#else
+    uint8_t* ip = vm->ip;
+    #define READ_BYTE() (*ip++)
+    #define SYNC_IP() (vm->ip = ip)
+#endif
+
     #define READ_CONSTANT() (vm->chunk->constants.items[READ_BYTE()])
-    #define BINARY_OP(value_type, op) \
+    // 24-bit index, low byte first
+    #define READ_CONSTANT_LONG() \
+        (wide_index = READ_BYTE(), \
+         wide_index |= READ_BYTE() << 8, \
+         wide_index |= READ_BYTE() << 16, \
+         vm->chunk->constants.items[wide_index])
+    // 16-bit global slot, low byte first
+    #define READ_GLOBAL_SLOT() \
+        (wide_index = READ_BYTE(), \
+         wide_index |= READ_BYTE() << 8, \
+         wide_index)
+    int wide_index;
+    // Globals are only added while compiling, the array stays put while
+    // the chunk runs
+    Value* globals = vm->globals.values.items;
+    #define UNDEFINED_GLOBAL(slot) \
+        RUNTIME_ERROR("Undefined variable '%s'.", vm->globals.names.items[slot]->name)
+#ifdef VM_REGISTER
+    // The stack array is the register file
+    Value* registers = vm->stack;
+    Value* constants = vm->chunk->constants.items;
+    #define READ_RK() \
+        (rk = READ_BYTE(), (rk & RK_CONSTANT) ? constants[rk & RK_MAX_CONSTANT] : registers[rk])
+    uint8_t rk;
+#endif
+    #define RUNTIME_ERROR(...) \
+        do { \
+            SYNC_IP(); \
+            runtime_error(vm, __VA_ARGS__); \
+            result = INTERPRET_RUNTIME_ERROR; \
+            goto done; \
+        } while (false)
+    // NUMBER_OP evaluates `result` over the number operands a and b
+#ifdef VM_REGISTER
+    #define NUMBER_OP(result) \
+        do { \
+            uint8_t dst = READ_BYTE(); \
+            Value left = READ_RK(); \
+            Value right = READ_RK(); \
+            if (!IS_NUMBER(left) || !IS_NUMBER(right)) { \
+                RUNTIME_ERROR("Operands must be numbers."); \
+            } \
+            double a = AS_NUMBER(left); \
+            double b = AS_NUMBER(right); \
+            registers[dst] = result; \
+        } while (false)
+#else
+    #define NUMBER_OP(result) \
         do { \
             if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) { \
-                runtime_error(vm, "Operands must be numbers."); \
-                return INTERPRET_RUNTIME_ERROR; \
+                RUNTIME_ERROR("Operands must be numbers."); \
             } \
             double b = AS_NUMBER(pop(vm)); \
             double a = AS_NUMBER(pop(vm)); \
-            push(vm, value_type(a op b)); \
+            push(vm, result); \
+        } while (false)
+    // The right operand is an inline constant and the result replaces the top
+    #define CONSTANT_OP(result) \
+        do { \
+            Value right = READ_CONSTANT(); \
+            if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(right)) { \
+                RUNTIME_ERROR("Operands must be numbers."); \
+            } \
+            double a = AS_NUMBER(vm->stack_top[-1]); \
+            double b = AS_NUMBER(right); \
+            vm->stack_top[-1] = result; \
+        } while (false)
+#endif
+    #define BINARY_OP(value_type, op) NUMBER_OP(value_type(a op b))
+
+#ifdef VM_PAIR_STATS
+    int previous_op = -1;
+#ifdef VM_PREDECODE
+    #define CURRENT_OP() (vm->chunk->items[ip - code])
+#else
+    #define CURRENT_OP() (*ip)
+#endif
+    #define COUNT_PAIR() \
+        do { \
+            uint8_t op = CURRENT_OP(); \
+            if (previous_op >= 0) pair_counts[previous_op][op]++; \
+            previous_op = op; \
         } while (false)
+#else
+    #define COUNT_PAIR() do {} while (false)
+#endif
 
+#ifdef DEBUG_TRACE_EXECUTION
+    #define TRACE() \
+        do { \
+            printf("          "); \
+            for (Value* slot = vm->stack; slot < vm->stack_top; slot++) { \
+                printf("[ "); \
+                print_value(*slot); \
+                printf(" ]"); \
+            } \
+            SYNC_IP(); \
+            disassemble_instruction(vm->chunk, (int)(vm->ip - vm->chunk->items)); \
+        } while (false)
+#else
+    #define TRACE() do {} while (false)
+#endif
+
+#if defined(VM_PREDECODE)
+    #define DISPATCH() do { TRACE(); COUNT_PAIR(); goto **ip++; } while (false)
+    #define CASE(op)   do_##op
+#elif defined(VM_COMPUTED_GOTO)
+    #define DISPATCH() do { TRACE(); COUNT_PAIR(); goto *dispatch_table[READ_BYTE()]; } while (false)
+    #define CASE(op)   do_##op
+#else
+    #define DISPATCH() continue
+    #define CASE(op)   case op
+#endif
+    #define NEXT() DISPATCH()
+
+#ifdef VM_COMPUTED_GOTO
+    DISPATCH();
+    {
+#else
     for (;;) {
-    #ifdef DEBUG_TRACE_EXECUTION
-        printf("          ");
-        for (Value* slot = vm->stack; slot < vm->stack_top; slot++) {
-            printf("[ ");
-            print_value(*slot);
-            printf(" ]");
-        }
-        disassemble_instruction(vm->chunk, (int)(vm->ip - vm->chunk->items));
-    #endif
-        uint8_t instruction;
-        switch (instruction = READ_BYTE()) {
-        case OP_CONSTANT: {
-            Value constant = READ_CONSTANT();
-            push(vm, constant);
-            break;
-        }
-        case OP_NIL: push(vm, NIL_VAL); break;
-        case OP_TRUE: push(vm, BOOL_VAL(true)); break;
-        case OP_FALSE: push(vm, BOOL_VAL(false)); break;
-        case OP_EQUAL: {
-            Value b = pop(vm);
-            Value a = pop(vm);
-            push(vm, BOOL_VAL(values_equal(a, b)));
-            break;
+    TRACE();
+    COUNT_PAIR();
+    switch (READ_BYTE()) {
+#endif
+#ifdef VM_REGISTER
+    CASE(OP_CONSTANT): {
+        uint8_t dst = READ_BYTE();
+        registers[dst] = READ_CONSTANT();
+        NEXT();
+    }
+    CASE(OP_CONSTANT_LONG): {
+        uint8_t dst = READ_BYTE();
+        registers[dst] = READ_CONSTANT_LONG();
+        NEXT();
+    }
+    CASE(OP_EQUAL): {
+        uint8_t dst = READ_BYTE();
+        Value a = READ_RK();
+        Value b = READ_RK();
+        registers[dst] = BOOL_VAL(values_equal(a, b));
+        NEXT();
+    }
+    CASE(OP_GREATER):  BINARY_OP(BOOL_VAL, >); NEXT();
+    CASE(OP_LESS):     BINARY_OP(BOOL_VAL, <); NEXT();
+    CASE(OP_ADD):      BINARY_OP(NUMBER_VAL, +); NEXT();
+    CASE(OP_SUBTRACT): BINARY_OP(NUMBER_VAL, -); NEXT();
+    CASE(OP_MULTIPLY): BINARY_OP(NUMBER_VAL, *); NEXT();
+    CASE(OP_DIVIDE):   BINARY_OP(NUMBER_VAL, /); NEXT();
+    CASE(OP_NOT): {
+        uint8_t dst = READ_BYTE();
+        registers[dst] = BOOL_VAL(is_falsey(READ_RK()));
+        NEXT();
+    }
+    CASE(OP_NEGATE): {
+        uint8_t dst = READ_BYTE();
+        Value value = READ_RK();
+        if (!IS_NUMBER(value)) {
+            RUNTIME_ERROR("Operand must be a number.");
         }
-        case OP_GREATER:  BINARY_OP(BOOL_VAL, >); break;
-        case OP_LESS:     BINARY_OP(BOOL_VAL, <); break;
-        case OP_ADD:      BINARY_OP(NUMBER_VAL, +); break;
-        case OP_SUBTRACT: BINARY_OP(NUMBER_VAL, -); break;
-        case OP_MULTIPLY: BINARY_OP(NUMBER_VAL, *); break;
-        case OP_DIVIDE:   BINARY_OP(NUMBER_VAL, /); break;  
-        case OP_NOT:
-            push(vm, BOOL_VAL(is_falsey(pop(vm))));
-            break;
-        case OP_NEGATE:
-            if (!IS_NUMBER(peek(vm, 0))) {
-                runtime_error(vm, "Operand must be a number.");
-                return INTERPRET_RUNTIME_ERROR;
-            }
-            push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
-            break;
-        case OP_RETURN:
-            print_value(pop(vm));
-            printf("\n");
-            return INTERPRET_OK;
+        registers[dst] = NUMBER_VAL(-AS_NUMBER(value));
+        NEXT();
+    }
+    CASE(OP_GET_GLOBAL): {
+        uint8_t dst = READ_BYTE();
+        int slot = READ_GLOBAL_SLOT();
+        if (IS_UNDEFINED(globals[slot])) UNDEFINED_GLOBAL(slot);
+        registers[dst] = globals[slot];
+        NEXT();
+    }
+    CASE(OP_DEFINE_GLOBAL): {
+        Value value = READ_RK();
+        int slot = READ_GLOBAL_SLOT();
+        globals[slot] = value;
+        NEXT();
+    }
+    CASE(OP_SET_GLOBAL): {
+        Value value = READ_RK();
+        int slot = READ_GLOBAL_SLOT();
+        if (IS_UNDEFINED(globals[slot])) UNDEFINED_GLOBAL(slot);
+        globals[slot] = value;
+        NEXT();
+    }
+    CASE(OP_PRINT):
+        print_value(READ_RK());
+        printf("\n");
+        NEXT();
+    CASE(OP_RETURN):
+        result = INTERPRET_OK;
+        goto done;
+    CASE(OP_NOT_EQUAL): {
+        uint8_t dst = READ_BYTE();
+        Value a = READ_RK();
+        Value b = READ_RK();
+        registers[dst] = BOOL_VAL(!values_equal(a, b));
+        NEXT();
+    }
+    CASE(OP_GREATER_EQUAL): NUMBER_OP(BOOL_VAL(!(a < b))); NEXT();
+    CASE(OP_LESS_EQUAL):    NUMBER_OP(BOOL_VAL(!(a > b))); NEXT();
+#else
+    CASE(OP_CONSTANT): {
+        Value constant = READ_CONSTANT();
+        push(vm, constant);
+        NEXT();
+    }
+    CASE(OP_CONSTANT_LONG): {
+        Value constant = READ_CONSTANT_LONG();
+        push(vm, constant);
+        NEXT();
+    }
+    CASE(OP_NIL):   push(vm, NIL_VAL); NEXT();
+    CASE(OP_TRUE):  push(vm, BOOL_VAL(true)); NEXT();
+    CASE(OP_FALSE): push(vm, BOOL_VAL(false)); NEXT();
+    CASE(OP_EQUAL): {
+        Value b = pop(vm);
+        Value a = pop(vm);
+        push(vm, BOOL_VAL(values_equal(a, b)));
+        NEXT();
+    }
+    CASE(OP_GREATER):  BINARY_OP(BOOL_VAL, >); NEXT();
+    CASE(OP_LESS):     BINARY_OP(BOOL_VAL, <); NEXT();
+    CASE(OP_ADD):      BINARY_OP(NUMBER_VAL, +); NEXT();
+    CASE(OP_SUBTRACT): BINARY_OP(NUMBER_VAL, -); NEXT();
+    CASE(OP_MULTIPLY): BINARY_OP(NUMBER_VAL, *); NEXT();
+    CASE(OP_DIVIDE):   BINARY_OP(NUMBER_VAL, /); NEXT();
+    CASE(OP_NOT):
+        push(vm, BOOL_VAL(is_falsey(pop(vm))));
+        NEXT();
+    CASE(OP_NEGATE):
+        if (!IS_NUMBER(peek(vm, 0))) {
+            RUNTIME_ERROR("Operand must be a number.");
         }
+        push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
+        NEXT();
+    CASE(OP_POP): pop(vm); NEXT();
+    CASE(OP_GET_GLOBAL): {
+        int slot = READ_GLOBAL_SLOT();
+        if (IS_UNDEFINED(globals[slot])) UNDEFINED_GLOBAL(slot);
+        push(vm, globals[slot]);
+        NEXT();
+    }
+    CASE(OP_DEFINE_GLOBAL): {
+        int slot = READ_GLOBAL_SLOT();
+        globals[slot] = pop(vm);
+        NEXT();
+    }
+    CASE(OP_SET_GLOBAL): {
+        // Assignment is an expression, its value stays on the stack
+        int slot = READ_GLOBAL_SLOT();
+        if (IS_UNDEFINED(globals[slot])) UNDEFINED_GLOBAL(slot);
+        globals[slot] = peek(vm, 0);
+        NEXT();
+    }
+    CASE(OP_PRINT):
+        print_value(pop(vm));
+        printf("\n");
+        NEXT();
+    CASE(OP_RETURN):
+        result = INTERPRET_OK;
+        goto done;
+    CASE(OP_NOT_EQUAL): {
+        Value b = pop(vm);
+        Value a = pop(vm);
+        push(vm, BOOL_VAL(!values_equal(a, b)));
+        NEXT();
+    }
+    CASE(OP_GREATER_EQUAL):  NUMBER_OP(BOOL_VAL(!(a < b))); NEXT();
+    CASE(OP_LESS_EQUAL):     NUMBER_OP(BOOL_VAL(!(a > b))); NEXT();
+    CASE(OP_ADD_CONST):      CONSTANT_OP(NUMBER_VAL(a + b)); NEXT();
+    CASE(OP_SUBTRACT_CONST): CONSTANT_OP(NUMBER_VAL(a - b)); NEXT();
+    CASE(OP_MULTIPLY_CONST): CONSTANT_OP(NUMBER_VAL(a * b)); NEXT();
+    CASE(OP_CHECK_GLOBAL): {
+        // A global read as a statement still fails when it is undefined
+        int slot = READ_GLOBAL_SLOT();
+        if (IS_UNDEFINED(globals[slot])) UNDEFINED_GLOBAL(slot);
+        NEXT();
     }
+#endif
+    }
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+
+done:
+    SYNC_IP();
+#ifdef VM_PREDECODE
+    release(code);
+#endif
+    return result;
 
     #undef READ_BYTE
+    #undef SYNC_IP
     #undef READ_CONSTANT
+    #undef READ_CONSTANT_LONG
+    #undef READ_GLOBAL_SLOT
+    #undef UNDEFINED_GLOBAL
+    #undef READ_RK
+    #undef RUNTIME_ERROR
+    #undef NUMBER_OP
+    #undef CONSTANT_OP
     #undef BINARY_OP
+    #undef TRACE
+    #undef CURRENT_OP
+    #undef COUNT_PAIR
+    #undef DISPATCH
+    #undef CASE
+    #undef NEXT
 }
 
 InterpretResult interpret(VM* vm, const char* source)
+{
+    return interpret_repeated(vm, source, 1);
+}
+
+InterpretResult interpret_repeated(VM* vm, const char* source, int runs)
 {
     Chunk chunk;
     init_chunk(&chunk);
 
-    if (!compile(source, &chunk)) {
+    if (!compile(source, &chunk, &vm->globals)) {
         free_chunk(&chunk);
         return INTERPRET_COMPILE_ERROR;
     }
 
+    reserve_stack(vm, chunk.max_stack);
     vm->chunk = &chunk;
-    vm->ip = vm->chunk->items;
 
-    InterpretResult result = run(vm);
+    InterpretResult result = INTERPRET_OK;
+    for (int i = 0; i < runs && result == INTERPRET_OK; i++) {
+        vm->ip = vm->chunk->items;
+        result = run(vm);
+    }
 
     free_chunk(&chunk);
     return result;
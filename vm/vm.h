@@ -1,14 +1,18 @@
 #pragma once
 
 #include "chunk.h"
+#include "globals.h"
 
-#define STACK_MAX 256
+// Slots the stack starts with, it grows when a chunk needs more
+#define STACK_INITIAL 256
 
 typedef struct {
     Chunk* chunk;
     uint8_t* ip;
-    Value stack[STACK_MAX];
+    Value* stack;
+    int stack_capacity;
     Value* stack_top;
+    Globals globals;
 } VM;
 
 typedef enum {
@@ -21,5 +25,11 @@ VM init_vm();
 void free_vm(VM* vm);
 
 InterpretResult interpret(VM* vm, const char* source);
+// Compiles the source once and runs it `runs` times, stopping at the first error
+InterpretResult interpret_repeated(VM* vm, const char* source, int runs);
+#ifdef VM_PAIR_STATS
+// Prints the opcode pairs counted so far, most frequent first
+void print_pair_stats();
+#endif
 void push(VM* vm, Value value);
 Value pop(VM* vm);